@@ -0,0 +1,574 @@
+// Micro-benchmark for the placement engine. Runs the solvers on synthetic enemy layouts and
+// reports time and heap allocations per call, so regressions can be measured on a plain
+// Linux box without a core checkout. With --verify-zero-alloc the run fails (exit code 2) if
+// any operation still allocates once warmed up, which is what a steady-state cast must not do.
+// --threads runs full placements on several threads at once instead, one map's worth of
+// enemies per thread, and reports how total throughput scales with the thread count; it also
+// drives the per-map context registry the module keeps its map state in from every thread,
+// instance unloads included. --verify-contexts checks that per-map state stays with its map
+// while several threads update maps and destroy them (exit code 2 if not).
+//
+//   egt_placement_benchmark [--min-time-ms N] [--filter TEXT] [--verify-zero-alloc]
+//   egt_placement_benchmark --threads 1,2,4,8 [--min-time-ms N]
+//   egt_placement_benchmark --verify-contexts [--threads N]
+
+#include "PlacementContextRegistry.h"
+#include "PlacementEngine.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every global allocation in the process goes through here so a run can be charged for it
+static std::atomic<uint64_t> allocationCount{0};
+
+void* operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+// Level ground everywhere, caster fixed in place
+class FlatWorldQuery : public PlacementWorldQuery
+{
+public:
+    explicit FlatWorldQuery(PlacementPosition caster) : _caster(caster) {}
+
+    PlacementPosition GetCasterPosition() const override
+    {
+        return _caster;
+    }
+
+    void UpdateGroundZ(float /*x*/, float /*y*/, float& z) const override
+    {
+        z = _caster.z;
+    }
+
+private:
+    PlacementPosition _caster;
+};
+
+enum class Layout
+{
+    Uniform,   // spread evenly over a 60x60 yard square
+    Clustered, // a handful of tight packs
+    Ring       // a hollow ring, worst case for bounding-box centers
+};
+
+static char const* LayoutName(Layout layout)
+{
+    switch (layout)
+    {
+        case Layout::Uniform:   return "uniform";
+        case Layout::Clustered: return "clustered";
+        case Layout::Ring:      return "ring";
+    }
+
+    return "?";
+}
+
+// World-sized coordinates on purpose, the solvers must cope with float precision out there
+static PlacementPosition const benchCaster = { 1520.0f, -4380.0f, 25.0f };
+
+static std::vector<PlacementPoint> MakeLayout(Layout layout, uint32_t count, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<PlacementPoint> points;
+    points.reserve(count);
+
+    // Enemies sit around a spot 20 yards in front of the caster
+    float centerX = benchCaster.x + 20.0f;
+    float centerY = benchCaster.y;
+
+    switch (layout)
+    {
+        case Layout::Uniform:
+        {
+            std::uniform_real_distribution<float> offset(-30.0f, 30.0f);
+            for (uint32_t i = 0; i < count; ++i)
+                points.push_back({ centerX + offset(rng), centerY + offset(rng) });
+            break;
+        }
+        case Layout::Clustered:
+        {
+            uint32_t packs = std::max<uint32_t>(1, count / 25);
+            std::uniform_real_distribution<float> packOffset(-25.0f, 25.0f);
+            std::normal_distribution<float> spread(0.0f, 3.0f);
+
+            std::vector<PlacementPoint> centers;
+            for (uint32_t i = 0; i < packs; ++i)
+                centers.push_back({ centerX + packOffset(rng), centerY + packOffset(rng) });
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                PlacementPoint const& pack = centers[i % packs];
+                points.push_back({ pack.x + spread(rng), pack.y + spread(rng) });
+            }
+            break;
+        }
+        case Layout::Ring:
+        {
+            std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+            std::normal_distribution<float> jitter(0.0f, 0.75f);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                float a = angle(rng);
+                float r = 12.0f + jitter(rng);
+                points.push_back({ centerX + r * std::cos(a), centerY + r * std::sin(a) });
+            }
+            break;
+        }
+    }
+
+    return points;
+}
+
+struct BenchResult
+{
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    uint32_t hits;
+};
+
+// Repeats 'op' until at least minTime has passed; op returns the hit count it achieved
+static BenchResult Measure(std::function<uint32_t()> const& op, std::chrono::milliseconds minTime)
+{
+    using Clock = std::chrono::steady_clock;
+
+    uint32_t hits = op(); // warm-up, also primes caches and lazily resolved kernels
+
+    uint64_t iterations = 0;
+    uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+    Clock::time_point start = Clock::now();
+    Clock::time_point now = start;
+
+    do
+    {
+        for (uint32_t i = 0; i < 16; ++i)
+            hits = op();
+
+        iterations += 16;
+        now = Clock::now();
+    } while (now - start < minTime);
+
+    uint64_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+    double elapsed = double(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count());
+
+    return { iterations, elapsed / iterations, double(allocations) / iterations, hits };
+}
+
+// Every thread places on its own copy of one layout, like map threads each updating their
+// own map, for 'minTime'. Returns placements per second over all threads.
+static double MeasureThroughput(uint32_t threadCount, PlacementSolver solver, std::chrono::milliseconds minTime)
+{
+    std::atomic<bool> go{ false };
+    std::atomic<uint64_t> total{ 0 };
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&]()
+        {
+            std::vector<PlacementPoint> points = MakeLayout(Layout::Clustered, 100, 2000);
+            FlatWorldQuery world(benchCaster);
+            CalculateOptimalAOEPosition(world, points, 8.0f, 30.0f, solver); // warm-up
+
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            uint64_t placements = 0;
+            do
+            {
+                for (uint32_t i = 0; i < 16; ++i)
+                    CalculateOptimalAOEPosition(world, points, 8.0f, 30.0f, solver);
+
+                placements += 16;
+            } while (std::chrono::steady_clock::now() < deadline);
+
+            total.fetch_add(placements, std::memory_order_relaxed);
+        });
+    }
+
+    // One window for all threads, so the rate is what they achieve side by side
+    auto start = std::chrono::steady_clock::now();
+    deadline = start + minTime;
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(total.load()) / elapsed;
+}
+
+// Stand-in for the module's MapPlacementContext: a lookup table of the same size as its
+// line of sight cache, touched once per placement
+struct alignas(64) BenchMapContext
+{
+    std::vector<uint64_t> slots = std::vector<uint64_t>(8192);
+    uint64_t placements = 0;
+};
+
+struct BenchMap
+{
+    uint32_t id = 0;
+};
+
+static PlacementContextRegistry<BenchMap, BenchMapContext> benchMapContexts;
+
+// Every thread updates its own maps, a continent and an instance, looking the map's context
+// up for each placement the way the module's hooks do. Thread 0 also unloads and reloads its
+// instance now and then, which sends every thread back through the registry lock once.
+// Returns context lookups per second over all threads.
+static double MeasureContextThroughput(uint32_t threadCount, std::chrono::milliseconds minTime)
+{
+    constexpr uint32_t MAPS_PER_THREAD = 2;
+    constexpr uint32_t PLACEMENTS_PER_UPDATE = 16;
+    constexpr uint64_t UPDATES_PER_UNLOAD = 1024;
+
+    std::vector<BenchMap> maps(threadCount * MAPS_PER_THREAD);
+    std::atomic<bool> go{ false };
+    std::atomic<uint64_t> total{ 0 };
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            BenchMap* own = &maps[t * MAPS_PER_THREAD];
+            for (uint32_t m = 0; m < MAPS_PER_THREAD; ++m)
+                benchMapContexts.Get(&own[m]); // warm-up
+
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            uint64_t lookups = 0;
+            uint64_t updates = 0;
+            do
+            {
+                for (uint32_t m = 0; m < MAPS_PER_THREAD; ++m)
+                {
+                    for (uint32_t i = 0; i < PLACEMENTS_PER_UPDATE; ++i)
+                    {
+                        BenchMapContext& context = benchMapContexts.Get(&own[m]);
+                        ++context.slots[(context.placements++ * 2654435761u) & 8191];
+                    }
+                }
+
+                lookups += MAPS_PER_THREAD * PLACEMENTS_PER_UPDATE;
+                if (t == 0 && ++updates % UPDATES_PER_UNLOAD == 0)
+                    benchMapContexts.Destroy(&own[MAPS_PER_THREAD - 1]);
+            } while (std::chrono::steady_clock::now() < deadline);
+
+            total.fetch_add(lookups, std::memory_order_relaxed);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    deadline = start + minTime;
+    go.store(true, std::memory_order_release);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return double(total.load()) / elapsed;
+}
+
+// Stand-in for the module's MapPlacementContext holding the same kinds of state: a ground
+// height table, the tick's enemy snapshots and the time charged to the tick budget. The
+// real context needs a core (grid math, units); this one stamps every piece of state with
+// the map that wrote it, so a context handed to the wrong map, or a stale one handed out
+// after its map was destroyed, shows up.
+struct alignas(64) VerifyMapContext
+{
+    uint32_t owner = 0; // id of the map that first used it
+    std::vector<uint32_t> groundHeights = std::vector<uint32_t>(4096);
+    std::vector<uint32_t> snapshots;
+    uint64_t spentNs = 0;
+    uint64_t placements = 0;
+};
+
+static PlacementContextRegistry<BenchMap, VerifyMapContext> verifyMapContexts;
+
+// Looks up 'map' and checks its state is exactly what this thread left there: 'expected'
+// placements, all stamped with the map's id. Returns the number of broken checks.
+static uint32_t CheckMapContext(BenchMap const& map, uint64_t expected, VerifyMapContext& context)
+{
+    uint32_t failures = 0;
+    if (!expected)
+    {
+        // First use, or first use since the map was destroyed: must be a fresh context
+        failures += context.owner != 0 || context.placements != 0 || context.spentNs != 0 || !context.snapshots.empty();
+        context.owner = map.id;
+    }
+
+    failures += context.owner != map.id || context.placements != expected || context.spentNs != expected;
+    for (uint32_t id : context.snapshots)
+        failures += id != map.id;
+
+    return failures;
+}
+
+// Every thread updates its own maps, placing on each through the registry and writing its
+// caches, snapshots and budget, and now and then destroys one of them, which clears every
+// thread's lookaside. Afterwards one thread caches a map another one then destroys, which
+// its next lookup must notice. Returns the number of broken checks.
+static uint32_t VerifyContexts(uint32_t threadCount)
+{
+    constexpr uint32_t MAPS_PER_THREAD = 2;
+    constexpr uint32_t PLACEMENTS_PER_UPDATE = 16;
+    constexpr uint32_t UPDATES = 20000;
+    constexpr uint32_t UPDATES_PER_UNLOAD = 256;
+
+    std::vector<BenchMap> maps(threadCount * MAPS_PER_THREAD);
+    for (uint32_t i = 0; i < maps.size(); ++i)
+        maps[i].id = i + 1;
+
+    std::atomic<uint32_t> failures{ 0 };
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            BenchMap* own = &maps[t * MAPS_PER_THREAD];
+            uint64_t expected[MAPS_PER_THREAD] = { };
+            uint32_t broken = 0;
+
+            for (uint32_t update = 1; update <= UPDATES; ++update)
+            {
+                for (uint32_t m = 0; m < MAPS_PER_THREAD; ++m)
+                {
+                    // A new tick: the snapshots of the last one are dropped
+                    verifyMapContexts.Get(&own[m]).snapshots.clear();
+
+                    for (uint32_t i = 0; i < PLACEMENTS_PER_UPDATE; ++i)
+                    {
+                        VerifyMapContext& context = verifyMapContexts.Get(&own[m]);
+                        broken += CheckMapContext(own[m], expected[m], context);
+
+                        uint32_t& height = context.groundHeights[(context.placements * 2654435761u) & 4095];
+                        broken += height != 0 && height != own[m].id;
+                        height = own[m].id;
+                        context.snapshots.push_back(own[m].id);
+                        ++context.spentNs;
+                        ++context.placements;
+                        ++expected[m];
+                    }
+                }
+
+                if (update % UPDATES_PER_UNLOAD == 0)
+                {
+                    verifyMapContexts.Destroy(&own[MAPS_PER_THREAD - 1]);
+                    broken += verifyMapContexts.Find(&own[MAPS_PER_THREAD - 1], false) != nullptr;
+                    expected[MAPS_PER_THREAD - 1] = 0;
+                }
+            }
+
+            failures.fetch_add(broken, std::memory_order_relaxed);
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    // A lookaside entry cached on one thread must not outlive a Destroy on another
+    BenchMap shared;
+    shared.id = uint32_t(maps.size()) + 1;
+    VerifyMapContext* created = &verifyMapContexts.Get(&shared);
+    std::atomic<uint32_t> step{ 0 };
+    VerifyMapContext* before = nullptr;
+    VerifyMapContext* after = nullptr;
+
+    std::thread reader([&]()
+    {
+        before = verifyMapContexts.Find(&shared, false);
+        step.store(1, std::memory_order_release);
+        while (step.load(std::memory_order_acquire) != 2)
+            std::this_thread::yield();
+
+        after = verifyMapContexts.Find(&shared, false);
+    });
+
+    while (step.load(std::memory_order_acquire) != 1)
+        std::this_thread::yield();
+
+    verifyMapContexts.Destroy(&shared);
+    step.store(2, std::memory_order_release);
+    reader.join();
+
+    return failures.load() + (before != created) + (after != nullptr);
+}
+
+static int RunScaling(std::vector<uint32_t> const& threadCounts, std::chrono::milliseconds minTime)
+{
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+    std::printf("%-16s %8s %14s %14s %9s\n", "operation", "threads", "placements/s", "per thread", "scaling");
+
+    for (auto const& [name, solver] : { std::make_pair("place/cluster", PLACEMENT_SOLVER_CLUSTER_CENTER),
+        std::make_pair("place/coverage", PLACEMENT_SOLVER_MAX_COVERAGE), std::make_pair("place/densitymap", PLACEMENT_SOLVER_DENSITY_MAP) })
+    {
+        double single = 0.0;
+        for (uint32_t threads : threadCounts)
+        {
+            double rate = MeasureThroughput(threads, solver, minTime);
+            if (single == 0.0)
+                single = rate / threads;
+
+            std::printf("%-16s %8u %14.0f %14.0f %8.2fx\n", name, threads, rate, rate / threads, rate / single);
+        }
+    }
+
+    double single = 0.0;
+    for (uint32_t threads : threadCounts)
+    {
+        double rate = MeasureContextThroughput(threads, minTime);
+        if (single == 0.0)
+            single = rate / threads;
+
+        std::printf("%-16s %8u %14.0f %14.0f %8.2fx\n", "mapcontext", threads, rate, rate / threads, rate / single);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::chrono::milliseconds minTime(100);
+    std::string filter;
+    bool verifyZeroAlloc = false;
+    bool verifyContexts = false;
+    std::vector<uint32_t> threadCounts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--min-time-ms") && i + 1 < argc)
+            minTime = std::chrono::milliseconds(std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--verify-zero-alloc"))
+            verifyZeroAlloc = true;
+        else if (!std::strcmp(argv[i], "--verify-contexts"))
+            verifyContexts = true;
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            for (char* token = std::strtok(argv[++i], ","); token; token = std::strtok(nullptr, ","))
+                threadCounts.push_back(std::max(1, std::atoi(token)));
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--min-time-ms N] [--filter TEXT] [--verify-zero-alloc] [--threads N,N,...] [--verify-contexts]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (verifyContexts)
+    {
+        uint32_t threads = threadCounts.empty() ? 4 : threadCounts.back();
+        uint32_t failures = VerifyContexts(threads);
+        std::printf("map contexts on %u threads: %u broken checks\n", threads, failures);
+        return failures ? 2 : 0;
+    }
+
+    if (!threadCounts.empty())
+        return RunScaling(threadCounts, minTime);
+
+    float const aoeRadius = 8.0f;
+    float const maxRange = 30.0f;
+    FlatWorldQuery world(benchCaster);
+    uint32_t allocating = 0;
+
+    std::printf("%-10s %6s  %-16s %10s %12s %10s %6s\n", "layout", "units", "operation", "iterations", "ns/op", "allocs/op", "hits");
+
+    for (Layout layout : { Layout::Uniform, Layout::Clustered, Layout::Ring })
+    {
+        for (uint32_t count : { 10u, 50u, 100u, 250u, 500u, 1000u, 2000u })
+        {
+            std::vector<PlacementPoint> points = MakeLayout(layout, count, 1000 + count);
+            std::vector<uint32_t> members;
+
+            std::vector<std::pair<char const*, std::function<uint32_t()>>> operations =
+            {
+                { "density", [&]() { FindMaxDensity(points, aoeRadius, members); return uint32_t(members.size()); } },
+                { "coverage", [&]()
+                    {
+                        float x, y;
+                        uint32_t hits = 0;
+                        FindMaxCoverageCenter(points, aoeRadius, x, y, hits);
+                        return hits;
+                    } },
+                { "densitymap", [&]()
+                    {
+                        float x, y;
+                        uint32_t hits = 0;
+                        FindDensityMapCenter(points, aoeRadius, { benchCaster.x, benchCaster.y }, maxRange - PLACEMENT_RANGE_MARGIN, x, y, hits);
+                        return hits;
+                    } },
+                { "place/cluster", [&]() { return CalculateOptimalAOEPosition(world, points, aoeRadius, maxRange, PLACEMENT_SOLVER_CLUSTER_CENTER).targetCount; } },
+                { "place/coverage", [&]() { return CalculateOptimalAOEPosition(world, points, aoeRadius, maxRange, PLACEMENT_SOLVER_MAX_COVERAGE).targetCount; } },
+                { "place/densitymap", [&]() { return CalculateOptimalAOEPosition(world, points, aoeRadius, maxRange, PLACEMENT_SOLVER_DENSITY_MAP).targetCount; } }
+            };
+
+            for (auto const& [name, op] : operations)
+            {
+                std::string label = std::string(LayoutName(layout)) + "/" + std::to_string(count) + "/" + name;
+                if (!filter.empty() && label.find(filter) == std::string::npos)
+                    continue;
+
+                BenchResult result = Measure(op, minTime);
+                std::printf("%-10s %6u  %-16s %10llu %12.1f %10.2f %6u\n", LayoutName(layout), count, name,
+                    static_cast<unsigned long long>(result.iterations), result.nsPerOp, result.allocsPerOp, result.hits);
+
+                if (result.allocsPerOp > 0.0)
+                    ++allocating;
+            }
+        }
+    }
+
+    if (verifyZeroAlloc && allocating)
+    {
+        std::printf("%u operations allocate in steady state\n", allocating);
+        return 2;
+    }
+
+    return 0;
+}
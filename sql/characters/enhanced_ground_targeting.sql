@@ -0,0 +1,7 @@
+-- Saved .toggle preference per character.
+-- Loaded asynchronously on login; changes are written back in batches every few seconds.
+CREATE TABLE IF NOT EXISTS `mod_enhanced_ground_targeting` (
+  `guid` INT UNSIGNED NOT NULL COMMENT 'characters.guid',
+  `enabled` TINYINT UNSIGNED NOT NULL DEFAULT 0,
+  PRIMARY KEY (`guid`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4;
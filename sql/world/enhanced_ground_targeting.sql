@@ -1,7 +1,11 @@
 -- Clean up any existing entries
 DELETE FROM spell_script_names WHERE ScriptName = 'spell_enhanced_ground_targeting';
 
--- Add entries for spells that require manual ground targeting
+-- Add entries for spells that require manual ground targeting.
+-- This table is the only spell list: the module builds its spell-ID lookup from these rows
+-- at startup. A negative spell_id covers every rank of that spell. Only spells aimed at a
+-- destination belong here: Mind Sear (aimed at a unit), Starfall (centered on the caster)
+-- and Army of the Dead (summons around the caster) take none.
 
 -- WARLOCK SPELLS
 INSERT INTO spell_script_names (spell_id, ScriptName) VALUES 
@@ -37,11 +41,6 @@ INSERT INTO spell_script_names (spell_id, ScriptName) VALUES
 (42926, 'spell_enhanced_ground_targeting'),   -- Flamestrike Rank 9
 
 -- PRIEST SPELLS
-(48045, 'spell_enhanced_ground_targeting'),   -- Mind Sear Rank 1
-(53023, 'spell_enhanced_ground_targeting'),   -- Mind Sear Rank 2
-(49821, 'spell_enhanced_ground_targeting'),   -- Mind Sear Rank 1 (incorrect rank)
-(53022, 'spell_enhanced_ground_targeting'),   -- Mind Sear Rank 2 (incorrect rank)
-
 (32375, 'spell_enhanced_ground_targeting'),   -- Mass Dispel
 
 -- DRUID SPELLS
@@ -51,11 +50,6 @@ INSERT INTO spell_script_names (spell_id, ScriptName) VALUES
 (27012, 'spell_enhanced_ground_targeting'),   -- Hurricane Rank 4
 (48466, 'spell_enhanced_ground_targeting'),   -- Hurricane Rank 5
 
-(50288, 'spell_enhanced_ground_targeting'),   -- Starfall Rank 1
-(53188, 'spell_enhanced_ground_targeting'),   -- Starfall Rank 2
-(53189, 'spell_enhanced_ground_targeting'),   -- Starfall Rank 3
-(53190, 'spell_enhanced_ground_targeting'),   -- Starfall Rank 4
-
 -- HUNTER SPELLS
 (1510, 'spell_enhanced_ground_targeting'),    -- Volley Rank 1
 (14294, 'spell_enhanced_ground_targeting'),   -- Volley Rank 2
@@ -70,7 +64,5 @@ INSERT INTO spell_script_names (spell_id, ScriptName) VALUES
 (49937, 'spell_enhanced_ground_targeting'),   -- Death and Decay Rank 3
 (49938, 'spell_enhanced_ground_targeting'),   -- Death and Decay Rank 4
 
-(42650, 'spell_enhanced_ground_targeting'),   -- Army of the Dead
-
 -- ROGUE SPELLS
 (1725, 'spell_enhanced_ground_targeting');    -- Distract
\ No newline at end of file
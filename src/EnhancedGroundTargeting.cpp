@@ -12,223 +12,1792 @@
 #include "Unit.h"
 #include "GameObject.h"
 #include "World.h"
+#include "WorldSession.h"
 #include "Pet.h"
-#include <unordered_map>
+#include "Timer.h"
+#include "GameTime.h"
+#include "ObjectAccessor.h"
+#include "GridDefines.h"
+#include "DatabaseEnv.h"
+#include "SpellMgr.h"
+#include "EnhancedGroundTargetingAPI.h"
+#include "PlacementContextRegistry.h"
+#include "PlacementEngine.h"
+#include "PlacementStats.h"
+#include "PlacementTrace.h"
+#include <atomic>
 #include <mutex>
+#include <unordered_map>
+#include <memory>
 #include <algorithm>
 #include <vector>
-#include <map>
-#include <list>
 #include <cmath>
+#include <fstream>
+#include <string>
+#include <bit>
+
+// Where smart positioning gets its candidate enemies from
+enum CandidateSource : uint32
+{
+    CANDIDATE_SOURCE_COMBAT_REFERENCES = 0, // threat and attacker lists of the player and pet, plus the selected unit
+    CANDIDATE_SOURCE_AREA_SCAN         = 1  // every unit within reach of the spell, filtered by the same rules
+};
+
+// Module configuration, read from sConfigMgr once per config load. Hot paths get it with a
+// single atomic pointer load; a reload publishes a new snapshot instead of editing the live one.
+struct EnhancedGroundTargetingConfig
+{
+    bool enabled = true;
+    bool autoTarget = true;
+    bool combatOnly = true;
+    bool smartPositioning = true;
+    uint32 minEnemiesForSmart = 2;
+    PlacementSolver placementSolver = PLACEMENT_SOLVER_MAX_COVERAGE;
+    uint32 densityMapThreshold = 100; // candidates from which the density map solver takes over, 0 = never
+    CandidateSource candidateSource = CANDIDATE_SOURCE_COMBAT_REFERENCES;
+    bool statsEnabled = true;
+    uint32 statsDumpInterval = 0; // seconds, 0 = never
+    std::string statsDumpFile = "EnhancedGroundTargeting_stats.log";
+    bool traceEnabled = false;
+    std::string traceFile = "EnhancedGroundTargeting.trace";
+    uint32 traceMaxFileSize = 64; // MB
+    uint32 traceMaxFiles = 4;
+    uint32 tickBudget = 2000; // microseconds of placement work per map per tick, 0 = unlimited
+    bool lineOfSight = true;  // drop candidates and centers the caster cannot see
+};
+
+static EnhancedGroundTargetingConfig const defaultConfig;
+static std::atomic<EnhancedGroundTargetingConfig const*> activeConfig{ &defaultConfig };
+
+// Every snapshot ever published. Readers may still hold the previous one while a reload
+// swaps it out, so snapshots are only freed at shutdown; reloads are rare enough for that.
+static std::vector<std::unique_ptr<EnhancedGroundTargetingConfig const>> publishedConfigs;
+
+EnhancedGroundTargetingConfig const& GetModuleConfig()
+{
+    return *activeConfig.load(std::memory_order_acquire);
+}
+
+// Builds a snapshot from the config file and publishes it. World thread only.
+EnhancedGroundTargetingConfig const& LoadModuleConfig()
+{
+    auto config = std::make_unique<EnhancedGroundTargetingConfig>();
+    config->enabled = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Enable", true);
+    config->autoTarget = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.AutoTarget", true);
+    config->combatOnly = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.CombatOnly", true);
+    config->smartPositioning = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.SmartPositioning", true);
+    config->minEnemiesForSmart = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.MinEnemiesForSmart", 2);
+    config->placementSolver = PlacementSolver(sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.PlacementSolver", PLACEMENT_SOLVER_MAX_COVERAGE));
+    if (config->placementSolver >= MAX_PLACEMENT_SOLVERS)
+    {
+        LOG_ERROR("server.loading", "Enhanced Ground Targeting: EnhancedGroundTargeting.PlacementSolver = {} is not a solver, using 1", uint32(config->placementSolver));
+        config->placementSolver = PLACEMENT_SOLVER_MAX_COVERAGE;
+    }
+    
+    config->densityMapThreshold = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.DensityMapThreshold", 100);
+    config->candidateSource = CandidateSource(sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.CandidateSource", CANDIDATE_SOURCE_COMBAT_REFERENCES));
+    config->statsEnabled = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Stats.Enable", true);
+    config->statsDumpInterval = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.Stats.DumpInterval", 0);
+    config->statsDumpFile = sConfigMgr->GetOption<std::string>("EnhancedGroundTargeting.Stats.DumpFile", "EnhancedGroundTargeting_stats.log");
+    
+    config->tickBudget = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.TickBudget", 2000);
+    config->lineOfSight = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.LineOfSight", true);
+    config->traceEnabled = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Trace.Enable", false);
+    config->traceFile = sConfigMgr->GetOption<std::string>("EnhancedGroundTargeting.Trace.File", "EnhancedGroundTargeting.trace");
+    config->traceMaxFileSize = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.Trace.MaxFileSize", 64);
+    config->traceMaxFiles = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.Trace.MaxFiles", 4);
+    
+    SetPlacementStatsEnabled(config->statsEnabled);
+    
+    activeConfig.store(config.get(), std::memory_order_release);
+    publishedConfigs.push_back(std::move(config));
+    return *publishedConfigs.back();
+}
+
+// How a spell's destination is chosen. Classified once per spell, from its effects, and
+// used to pick the placement pipeline the spell runs.
+enum PlacementKind : uint8
+{
+    PLACEMENT_KIND_AREA           = 0, // ground AoE with a cast time, refreshed as the cast completes
+    PLACEMENT_KIND_CHANNELED_AREA = 1, // ground AoE channeled from the moment it is placed
+    PLACEMENT_KIND_SUMMON         = 2, // summons and rituals without an area, placed beside the caster
+    PLACEMENT_KIND_DISTRACT       = 3, // placed on the selected unit, never on a cluster
+    MAX_PLACEMENT_KINDS
+};
+
+// What placement needs to know about a spell, taken from its SpellInfo
+struct SpellGeometry
+{
+    float radius;   // largest effect radius; the area the AoE actually covers
+    float maxRange; // how far from the caster the center may be placed
+    bool channeled;
+    bool lineOfSight; // the core requires the center to be in line of sight
+    PlacementKind kind;
+};
+
+// Radius used when a spell has no effect radius of its own
+static constexpr float DEFAULT_AOE_RADIUS = 8.0f;
+
+SpellGeometry BuildSpellGeometry(SpellInfo const* spellInfo)
+{
+    SpellGeometry geometry;
+    geometry.radius = 0.0f;
+    geometry.maxRange = spellInfo->GetMaxRange(false);
+    geometry.channeled = spellInfo->IsChanneled();
+    geometry.lineOfSight = !spellInfo->HasAttribute(SPELL_ATTR2_IGNORE_LINE_OF_SIGHT);
+    
+    for (uint8 i = 0; i < MAX_SPELL_EFFECTS; ++i)
+        if (spellInfo->Effects[i].HasRadius())
+            geometry.radius = std::max(geometry.radius, spellInfo->Effects[i].CalcRadius());
+    
+    // A summon that also strikes an area (Inferno) is placed like any other AoE
+    if (spellInfo->HasEffect(SPELL_EFFECT_DISTRACT))
+        geometry.kind = PLACEMENT_KIND_DISTRACT;
+    else if (geometry.radius <= 0.0f && (spellInfo->HasEffect(SPELL_EFFECT_SUMMON) || spellInfo->HasEffect(SPELL_EFFECT_SUMMON_OBJECT_WILD)))
+        geometry.kind = PLACEMENT_KIND_SUMMON;
+    else
+        geometry.kind = geometry.channeled ? PLACEMENT_KIND_CHANNELED_AREA : PLACEMENT_KIND_AREA;
+    
+    if (geometry.radius <= 0.0f)
+        geometry.radius = DEFAULT_AOE_RADIUS;
+    
+    return geometry;
+}
+
+// Spells bound to spell_enhanced_ground_targeting in spell_script_names, as a bitmap indexed
+// by spell ID plus their geometry stored densely in ID order. The server-wide AllSpellScript
+// hooks see every cast of every unit, so they test the bitmap first: one bounds check and one
+// bit test, no allocation. A geometry lookup adds a per-word rank and a popcount, still O(1).
+class RegisteredSpellTable
+{
+public:
+    // Entries in any order, duplicates allowed
+    void Build(std::vector<std::pair<uint32, SpellGeometry>> entries)
+    {
+        std::sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+        entries.erase(std::unique(entries.begin(), entries.end(), [](auto const& a, auto const& b) { return a.first == b.first; }), entries.end());
+        
+        _words.assign(entries.empty() ? 0 : (entries.back().first >> 6) + 1, 0);
+        _geometry.clear();
+        _geometry.reserve(entries.size());
+        
+        for (auto const& [spellId, geometry] : entries)
+        {
+            _words[spellId >> 6] |= uint64(1) << (spellId & 63);
+            _geometry.push_back(geometry);
+        }
+        
+        // Number of registered spells stored before each word
+        _ranks.resize(_words.size());
+        uint32 rank = 0;
+        for (size_t i = 0; i < _words.size(); ++i)
+        {
+            _ranks[i] = rank;
+            rank += std::popcount(_words[i]);
+        }
+    }
+    
+    bool Contains(uint32 spellId) const
+    {
+        uint32 word = spellId >> 6;
+        return word < _words.size() && ((_words[word] >> (spellId & 63)) & 1);
+    }
+    
+    SpellGeometry const* Find(uint32 spellId) const
+    {
+        if (!Contains(spellId))
+            return nullptr;
+        
+        uint32 word = spellId >> 6;
+        uint64 below = _words[word] & ((uint64(1) << (spellId & 63)) - 1);
+        return &_geometry[_ranks[word] + std::popcount(below)];
+    }
+    
+    uint32 Size() const { return _geometry.size(); }
+    
+private:
+    std::vector<uint64> _words;
+    std::vector<uint32> _ranks;
+    std::vector<SpellGeometry> _geometry;
+};
+
+static RegisteredSpellTable const emptySpellTable;
+static std::atomic<RegisteredSpellTable const*> registeredSpells{ &emptySpellTable };
+static std::unique_ptr<RegisteredSpellTable const> loadedSpellTable;
+
+bool IsRegisteredSpell(uint32 spellId)
+{
+    return registeredSpells.load(std::memory_order_acquire)->Contains(spellId);
+}
+
+// Table entry for registered spells, computed on the spot for anything else (.testcast)
+SpellGeometry GetSpellGeometry(SpellInfo const* spellInfo)
+{
+    if (SpellGeometry const* geometry = registeredSpells.load(std::memory_order_acquire)->Find(spellInfo->Id))
+        return *geometry;
+    
+    return BuildSpellGeometry(spellInfo);
+}
+
+// Generated from the same spell_script_names rows that attach the spell script, so the
+// hooks can never disagree with sql/world/enhanced_ground_targeting.sql. Startup only.
+void LoadRegisteredSpells()
+{
+    std::vector<std::pair<uint32, SpellGeometry>> entries;
+    auto addSpell = [&entries](SpellInfo const* spellInfo)
+    {
+        // Only spells aimed at a destination are placed; the hooks would strip the unit
+        // target of anything else or move a self-centered one. The SQL binds none of those,
+        // so this only catches rows added by hand.
+        if (!(spellInfo->GetExplicitTargetMask() & TARGET_FLAG_DEST_LOCATION))
+        {
+            LOG_WARN("server.loading", "Enhanced Ground Targeting: spell {} is bound but takes no destination, remove it from spell_script_names", spellInfo->Id);
+            return;
+        }
+        
+        entries.emplace_back(spellInfo->Id, BuildSpellGeometry(spellInfo));
+    };
+    
+    QueryResult result = WorldDatabase.Query("SELECT spell_id FROM spell_script_names WHERE ScriptName = 'spell_enhanced_ground_targeting'");
+    if (result)
+    {
+        do
+        {
+            int32 spellId = (*result)[0].Get<int32>();
+            
+            // Negative IDs bind the script to every rank of the spell
+            SpellInfo const* spellInfo = sSpellMgr->GetSpellInfo(uint32(std::abs(spellId)));
+            if (!spellInfo)
+                continue;
+            
+            if (spellId < 0)
+            {
+                for (SpellInfo const* rank = spellInfo->GetFirstRankSpell(); rank; rank = rank->GetNextRankSpell())
+                    addSpell(rank);
+            }
+            else
+                addSpell(spellInfo);
+        } while (result->NextRow());
+    }
+    
+    auto spells = std::make_unique<RegisteredSpellTable>();
+    spells->Build(std::move(entries));
+    
+    if (!spells->Size())
+        LOG_ERROR("server.loading", "Enhanced Ground Targeting: no spells registered, apply sql/world/enhanced_ground_targeting.sql to the world database");
+    else
+        LOG_INFO("server.loading", "Enhanced Ground Targeting: {} ground-targeted spells registered", spells->Size());
+
+    
+    registeredSpells.store(spells.get(), std::memory_order_release);
+    loadedSpellTable = std::move(spells);
+}
+
+// Ground heights already looked up on one map, keyed on the query point quantized to half a
+// yard horizontally and two yards vertically (so separate floors stay apart), plus the
+// caster's movement mode, since UpdateAllowedPositionZ answers differently for casters that
+// fly or swim. Least recently used entries are recycled once the cache is full, and entries
+// of a grid are dropped when the grid unloads. The index is a fixed open-addressed table, so
+// a miss allocates nothing. Only the thread updating the map touches it.
+class GroundHeightCache
+{
+public:
+    static constexpr uint32 CAPACITY = 4096;
+
+    GroundHeightCache() : _index(INDEX_SIZE, NONE)
+    {
+        _entries.reserve(CAPACITY);
+    }
+
+    // Bits of the movement mode part of the key
+    static constexpr uint32 MODE_FLY = 1;
+    static constexpr uint32 MODE_SWIM = 2;
+    
+    bool Find(float x, float y, float z, uint32 mode, float& groundZ)
+    {
+        uint32 position = FindPosition(MakeKey(x, y, z, mode));
+        if (_index[position] == NONE)
+            return false;
+
+        uint32 slot = _index[position];
+        MoveToFront(slot);
+        groundZ = _entries[slot].groundZ;
+        return true;
+    }
+
+    void Insert(float x, float y, float z, uint32 mode, float groundZ)
+    {
+        uint64 key = MakeKey(x, y, z, mode);
+        GridCoord grid = Acore::ComputeGridCoord(x, y);
+
+        uint32 position = FindPosition(key);
+        if (_index[position] != NONE)
+        {
+            uint32 slot = _index[position];
+            _entries[slot].groundZ = groundZ;
+            MoveToFront(slot);
+            return;
+        }
+
+        uint32 slot;
+        if (_entries.size() < CAPACITY)
+        {
+            slot = _entries.size();
+            _entries.emplace_back();
+        }
+        else
+        {
+            // Recycle the least recently used entry. A dead one's key may already belong to
+            // a live entry inserted since, whose index must survive.
+            slot = _tail;
+            Unlink(slot);
+            if (_entries[slot].live)
+            {
+                Erase(FindPosition(_entries[slot].key));
+                position = FindPosition(key);
+            }
+        }
+
+        Entry& entry = _entries[slot];
+        entry.key = key;
+        entry.groundZ = groundZ;
+        // In the numbering OnUnloadGridMap reports grids by, which runs the other way
+        entry.gridX = MAX_NUMBER_OF_GRIDS - 1 - grid.x_coord;
+        entry.gridY = MAX_NUMBER_OF_GRIDS - 1 - grid.y_coord;
+        entry.live = true;
+
+        _index[position] = slot;
+        PushFront(slot);
+    }
+
+    // Drops every entry inside grid (gridX, gridY), numbered as OnUnloadGridMap passes them;
+    // freed slots are reused before any eviction
+    void InvalidateGrid(uint32 gridX, uint32 gridY)
+    {
+        for (uint32 slot = 0; slot < _entries.size(); ++slot)
+        {
+            Entry& entry = _entries[slot];
+            if (!entry.live || entry.gridX != gridX || entry.gridY != gridY)
+                continue;
+
+            Erase(FindPosition(entry.key));
+            entry.live = false;
+
+            // Dead entries go to the back, where Insert recycles them first
+            Unlink(slot);
+            PushBack(slot);
+        }
+    }
+
+private:
+    static constexpr uint32 NONE = 0xFFFFFFFF;
+    
+    // Twice the capacity keeps linear probes short
+    static constexpr uint32 INDEX_SIZE = CAPACITY * 2;
+
+    struct Entry
+    {
+        uint64 key = 0;
+        float groundZ = 0.0f;
+        uint32 gridX = 0;
+        uint32 gridY = 0;
+        uint32 prev = NONE;
+        uint32 next = NONE;
+        bool live = false;
+    };
+
+    static uint64 MakeKey(float x, float y, float z, uint32 mode)
+    {
+        uint64 qx = uint32(int32(std::floor(x * 2.0f))) & 0x1FFFFF;
+        uint64 qy = uint32(int32(std::floor(y * 2.0f))) & 0x1FFFFF;
+        uint64 qz = uint32(int32(std::floor(z * 0.5f))) & 0x7FFFF;
+        return (qx << 42) | (qy << 21) | (qz << 2) | (mode & 3);
+    }
+
+    static uint32 Home(uint64 key)
+    {
+        return uint32((key * 0x9E3779B97F4A7C15ull) >> 32) & (INDEX_SIZE - 1);
+    }
+
+    // Position of 'key' in the index, or of the empty position where it would go
+    uint32 FindPosition(uint64 key) const
+    {
+        uint32 position = Home(key);
+        while (_index[position] != NONE && _entries[_index[position]].key != key)
+            position = (position + 1) & (INDEX_SIZE - 1);
+
+        return position;
+    }
+
+    // Empties an occupied position, shifting later entries of the probe run back so no
+    // lookup stops short at the hole
+    void Erase(uint32 hole)
+    {
+        for (uint32 position = (hole + 1) & (INDEX_SIZE - 1); _index[position] != NONE; position = (position + 1) & (INDEX_SIZE - 1))
+        {
+            uint32 home = Home(_entries[_index[position]].key);
+            if (((position - home) & (INDEX_SIZE - 1)) >= ((position - hole) & (INDEX_SIZE - 1)))
+            {
+                _index[hole] = _index[position];
+                hole = position;
+            }
+        }
+
+        _index[hole] = NONE;
+    }
+
+    void Unlink(uint32 slot)
+    {
+        Entry& entry = _entries[slot];
+        (entry.prev != NONE ? _entries[entry.prev].next : _head) = entry.next;
+        (entry.next != NONE ? _entries[entry.next].prev : _tail) = entry.prev;
+        entry.prev = entry.next = NONE;
+    }
+
+    void PushFront(uint32 slot)
+    {
+        Entry& entry = _entries[slot];
+        entry.prev = NONE;
+        entry.next = _head;
+        (_head != NONE ? _entries[_head].prev : _tail) = slot;
+        _head = slot;
+    }
+
+    void PushBack(uint32 slot)
+    {
+        Entry& entry = _entries[slot];
+        entry.next = NONE;
+        entry.prev = _tail;
+        (_tail != NONE ? _entries[_tail].next : _head) = slot;
+        _tail = slot;
+    }
+
+    void MoveToFront(uint32 slot)
+    {
+        if (slot == _head)
+            return;
+
+        Unlink(slot);
+        PushFront(slot);
+    }
+
+    std::vector<Entry> _entries;
+    std::vector<uint32> _index; // entry slot per position, NONE if empty
+    uint32 _head = NONE;
+    uint32 _tail = NONE;
+};
+
+// Line of sight answers of one map, for pairs of (caster cell, target cell). The caster side
+// is quantized to a yard horizontally and two yards vertically; the target side to four
+// yards both ways, so enemies shuffling about inside a melee pack keep hitting the entry
+// the first of them created instead of costing a collision query each. Direct-mapped: a
+// pair has one slot and a colliding pair simply takes it over, so lookups and inserts are
+// O(1) with a fixed footprint. Answers expire after a short TTL because doors and other
+// gameobjects change line of sight without any terrain event. Only the thread updating the
+// map touches it.
+class LineOfSightCache
+{
+public:
+    static constexpr uint32 SLOTS = 8192;
+    static constexpr uint32 TTL = 2000; // milliseconds
+    
+    LineOfSightCache() : _entries(SLOTS) { }
+    
+    // Casters standing in the same cell share their entries
+    static uint64 CasterCell(float x, float y, float z)
+    {
+        return MakeKey(x, y, z * 0.5f);
+    }
+    
+    bool Find(float fromX, float fromY, float fromZ, float toX, float toY, float toZ, uint32 now, bool& visible) const
+    {
+        uint64 from = CasterCell(fromX, fromY, fromZ);
+        uint64 to = MakeKey(toX * TARGET_SCALE, toY * TARGET_SCALE, toZ * TARGET_SCALE);
+        Entry const& entry = _entries[Slot(from, to)];
+        if (!entry.valid || entry.from != from || entry.to != to || getMSTimeDiff(entry.inserted, now) > TTL)
+            return false;
+        
+        visible = entry.visible;
+        return true;
+    }
+    
+    void Insert(float fromX, float fromY, float fromZ, float toX, float toY, float toZ, uint32 now, bool visible)
+    {
+        uint64 from = CasterCell(fromX, fromY, fromZ);
+        uint64 to = MakeKey(toX * TARGET_SCALE, toY * TARGET_SCALE, toZ * TARGET_SCALE);
+        Entry& entry = _entries[Slot(from, to)];
+        entry.from = from;
+        entry.to = to;
+        entry.inserted = now;
+        entry.valid = true;
+        entry.visible = visible;
+    }
+    
+private:
+    struct Entry
+    {
+        uint64 from = 0;
+        uint64 to = 0;
+        uint32 inserted = 0;
+        bool valid = false;
+        bool visible = false;
+    };
+    
+    static constexpr float TARGET_SCALE = 0.25f;
+    
+    // Coordinates come in already scaled to cells
+    static uint64 MakeKey(float x, float y, float z)
+    {
+        uint64 qx = uint32(int32(std::floor(x))) & 0x1FFFFF;
+        uint64 qy = uint32(int32(std::floor(y))) & 0x1FFFFF;
+        uint64 qz = uint32(int32(std::floor(z))) & 0x1FFFFF;
+        return (qx << 42) | (qy << 21) | qz;
+    }
+    
+    static uint32 Slot(uint64 from, uint64 to)
+    {
+        uint64 hash = (from * 0x9E3779B97F4A7C15ull) ^ (to * 0xC2B2AE3D27D4EB4Full);
+        return uint32(hash >> 32) & (SLOTS - 1);
+    }
+    
+    std::vector<Entry> _entries;
+};
+
+// In-combat units around one spot of a map, captured once per world tick and shared by every
+// caster near that spot. Positions are parallel arrays, so each caster's range filter
+// streams through them and only dereferences the units that pass it.
+struct EnemySnapshot
+{
+    float centerX = 0.0f;
+    float centerY = 0.0f;
+    float centerZ = 0.0f;
+    float radius = 0.0f;
+    uint32 phaseMask = 0; // of the caster who took it; units in other phases were left out
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> zs;
+    std::vector<Unit*> units;
+};
+
+// Module state of one map for the current world tick: the enemy snapshots taken so far
+// ([0, used) are current, the rest keep their capacity for the next tick) and the placement
+// time spent against the tick budget
+struct MapTickContext
+{
+    uint32 mapId = 0;
+    uint32 instanceId = 0;
+    uint32 tick = 0;
+    uint32 used = 0;
+    std::vector<EnemySnapshot> snapshots;
+    uint64 spentNs = 0;
+};
+
+// Module state of one map. Only the thread updating the map touches it, so nothing in it
+// is locked, and each context sits on its own cache lines so maps updated side by side by
+// MapUpdate.Threads never contend for memory. Per-player state lives on the players
+// (EnhancedGroundTargetingPlayerData), which belong to the map the same way.
+struct alignas(64) MapPlacementContext
+{
+    GroundHeightCache groundHeights;
+    LineOfSightCache lineOfSight;
+    MapTickContext tick;
+};
+
+static PlacementContextRegistry<Map, MapPlacementContext> mapContexts;
+
+// The map's context, created on first use if 'create' is set; otherwise null for a map
+// nothing was placed on yet
+MapPlacementContext* FindMapPlacementContext(Map const* map, bool create)
+{
+    return mapContexts.Find(map, create);
+}
+
+MapPlacementContext& GetMapPlacementContext(Map const* map)
+{
+    return mapContexts.Get(map);
+}
+
+// Called when the map goes away; no thread is updating it any more by then
+void DestroyMapPlacementContext(Map const* map)
+{
+    mapContexts.Destroy(map);
+}
+
+GroundHeightCache& GetGroundHeightCache(Map const* map)
+{
+    return GetMapPlacementContext(map).groundHeights;
+}
+
+// The map's tick state, reset when a new world tick starts
+MapTickContext& GetMapTickContext(Map const* map)
+{
+    uint32 tick = uint32(GameTime::GetGameTimeMS().count());
+    
+    MapTickContext& context = GetMapPlacementContext(map).tick;
+    if (context.tick != tick || context.mapId != map->GetId() || context.instanceId != map->GetInstanceId())
+    {
+        context.mapId = map->GetId();
+        context.instanceId = map->GetInstanceId();
+        context.tick = tick;
+        context.used = 0;
+        context.spentNs = 0;
+    }
+    
+    return context;
+}
+
+// Placement time left for the caster's map in this tick; 'unlimited' when no budget is set
+struct PlacementBudget
+{
+    MapTickContext& context;
+    uint64 budgetNs;
+    
+    bool Unlimited() const { return !budgetNs; }
+    bool Exhausted() const { return budgetNs && context.spentNs >= budgetNs; }
+    uint64 Remaining() const { return Exhausted() ? 0 : budgetNs - context.spentNs; }
+    bool Affords(uint64 ns) const { return Unlimited() || ns <= Remaining(); }
+};
+
+PlacementBudget GetPlacementBudget(Unit* caster)
+{
+    return { GetMapTickContext(caster->GetMap()), uint64(GetModuleConfig().tickBudget) * 1000 };
+}
+
+// Charges the time since 'start' to the map's budget
+void ChargePlacementBudget(PlacementBudget& budget, std::chrono::steady_clock::time_point start)
+{
+    budget.context.spentNs += uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// UpdateAllowedPositionZ, answered from the map's cache when that spot was looked up before
+// by a caster moving the same way. On a transport the core leaves z as it is, so there is
+// nothing to cache.
+void UpdateGroundZ(Unit* caster, float x, float y, float& z)
+{
+    if (caster->GetTransport())
+    {
+        caster->UpdateAllowedPositionZ(x, y, z);
+        return;
+    }
+    
+    // The core lets players swim, and creatures only if they can
+    Creature* creature = caster->ToCreature();
+    uint32 mode = (caster->CanFly() ? GroundHeightCache::MODE_FLY : 0)
+        | (!creature || creature->CanSwim() ? GroundHeightCache::MODE_SWIM : 0);
+    
+    GroundHeightCache& cache = GetGroundHeightCache(caster->GetMap());
+    if (cache.Find(x, y, z, mode, z))
+        return;
+
+    float groundZ = z;
+    caster->UpdateAllowedPositionZ(x, y, groundZ);
+    cache.Insert(x, y, z, mode, groundZ);
+    z = groundZ;
+}
+
+// Targets are checked at about chest height, so folds of the ground in between don't hide them
+static constexpr float LINE_OF_SIGHT_TARGET_HEIGHT = 2.0f;
+
+// Moving average of one uncached collision query, learnt per thread like the solver costs.
+// Starts pessimistic so a cold thread does not spend a whole tick before it has measured.
+static thread_local double lineOfSightQueryNs = 20000.0;
+static constexpr double LINE_OF_SIGHT_COST_SMOOTHING = 0.2;
+
+// Whether the caster may aim 'geometry' at (x, y, z) as far as line of sight goes, answered
+// from the map's cache when the same two spots were checked recently. With a budget, an
+// uncached query runs only if the budget affords it and is charged to it; otherwise the
+// spot counts as visible, leaving the decision to the check of the chosen center.
+bool IsInPlacementLineOfSight(Unit* caster, SpellGeometry const& geometry, float x, float y, float z, PlacementBudget* budget = nullptr)
+{
+    if (!geometry.lineOfSight || !GetModuleConfig().lineOfSight)
+        return true;
+    
+    LineOfSightCache& cache = GetMapPlacementContext(caster->GetMap()).lineOfSight;
+    uint32 now = getMSTime();
+    bool visible;
+    if (cache.Find(caster->GetPositionX(), caster->GetPositionY(), caster->GetPositionZ(), x, y, z, now, visible))
+        return visible;
+    
+    if (budget && !budget->Affords(uint64(lineOfSightQueryNs)))
+        return true;
+    
+    auto start = std::chrono::steady_clock::now();
+    visible = caster->IsWithinLOS(x, y, z + LINE_OF_SIGHT_TARGET_HEIGHT);
+    uint64 ns = uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    
+    lineOfSightQueryNs += LINE_OF_SIGHT_COST_SMOOTHING * (double(ns) - lineOfSightQueryNs);
+    if (budget)
+        budget->context.spentNs += ns;
+    
+    cache.Insert(caster->GetPositionX(), caster->GetPositionY(), caster->GetPositionZ(), x, y, z, now, visible);
+    return visible;
+}
+
+// Answers the placement engine's world lookups for a caster
+class CasterPlacementWorldQuery : public PlacementWorldQuery
+{
+public:
+    explicit CasterPlacementWorldQuery(Unit* caster) : _caster(caster) {}
+
+    PlacementPosition GetCasterPosition() const override
+    {
+        return { _caster->GetPositionX(), _caster->GetPositionY(), _caster->GetPositionZ() };
+    }
+
+    void UpdateGroundZ(float x, float y, float& z) const override
+    {
+        ::UpdateGroundZ(_caster, x, y, z);
+    }
+
+private:
+    Unit* _caster;
+};
+
+// AzerothCore-style position validation (based on SpellEffects.cpp research)
+void ValidateAndAdjustPosition(Unit* caster, float& x, float& y, float& z, SpellGeometry const& geometry)
+{
+    if (!caster)
+        return;
+    
+    ValidateAndAdjustPosition(CasterPlacementWorldQuery(caster), x, y, z, geometry.maxRange);
+}
+
+// Candidate range for spells without a max range
+static constexpr float ENEMY_SCAN_RANGE = 35.0f;
+
+// A snapshot serves every caster whose scan circle fits inside it: it reaches this much
+// past the scan range of the caster who took it. Kept small so the grid visit stays close
+// to the caster's own scan; casters standing together (a raid's ranged stack) still share.
+static constexpr float ENEMY_SNAPSHOT_SHARE_DISTANCE = 5.0f;
+
+// Units reserved per snapshot up front. A snapshot holds every unit in range; a more crowded
+// area grows it once, and the capacity is kept for the following ticks.
+static constexpr uint32 ENEMY_SNAPSHOT_RESERVE = 512;
+
+// Enemies farther than this cannot be hit by a spell centered within its max range
+float GetCandidateScanRange(SpellGeometry const& geometry)
+{
+    return geometry.maxRange > 0.0f ? geometry.maxRange + geometry.radius : ENEMY_SCAN_RANGE;
+}
+
+// Grid visitor filling a snapshot directly: range, phase, alive, selectable and in-combat
+// tests run as each unit is visited, so no intermediate list is built and idle units
+// (critters, mobs nobody pulled) never reach the snapshot
+class EnemySnapshotSearcher
+{
+public:
+    EnemySnapshotSearcher(WorldObject const* center, EnemySnapshot& snapshot)
+        : _phaseMask(center->GetPhaseMask()), _x(center->GetPositionX()), _y(center->GetPositionY()),
+        _z(center->GetPositionZ()), _rangeSq(snapshot.radius * snapshot.radius), _snapshot(snapshot) { }
+    
+    void Visit(PlayerMapType& m)
+    {
+        for (PlayerMapType::iterator itr = m.begin(); itr != m.end(); ++itr)
+            Add(itr->GetSource());
+    }
+    
+    void Visit(CreatureMapType& m)
+    {
+        for (CreatureMapType::iterator itr = m.begin(); itr != m.end(); ++itr)
+            Add(itr->GetSource());
+    }
+    
+    template<class NOT_INTERESTED> void Visit(GridRefMgr<NOT_INTERESTED>&) { }
+    
+private:
+    void Add(Unit* unit)
+    {
+        if (!unit->InSamePhase(_phaseMask))
+            return;
+        
+        float dx = unit->GetPositionX() - _x;
+        float dy = unit->GetPositionY() - _y;
+        float dz = unit->GetPositionZ() - _z;
+        if (dx * dx + dy * dy + dz * dz > _rangeSq)
+            return;
+        
+        if (!unit->IsInCombat() || !unit->IsAlive() || unit->HasUnitFlag(UNIT_FLAG_NOT_SELECTABLE))
+            return;
+        
+        _snapshot.xs.push_back(unit->GetPositionX());
+        _snapshot.ys.push_back(unit->GetPositionY());
+        _snapshot.zs.push_back(unit->GetPositionZ());
+        _snapshot.units.push_back(unit);
+    }
+    
+    uint32 _phaseMask;
+    float _x;
+    float _y;
+    float _z;
+    float _rangeSq;
+    EnemySnapshot& _snapshot;
+};
+
+EnemySnapshot const& GetEnemySnapshot(Unit* caster, float scanRange)
+{
+    MapTickContext& mapSnapshots = GetMapTickContext(caster->GetMap());
+    
+    float x = caster->GetPositionX();
+    float y = caster->GetPositionY();
+    float z = caster->GetPositionZ();
+    uint32 phaseMask = caster->GetPhaseMask();
+    
+    // The snapshot's sphere must hold the caster's whole scan sphere, so a caster on another
+    // floor or bridge level takes its own, as does one that sees other phases
+    for (uint32 i = 0; i < mapSnapshots.used; ++i)
+    {
+        EnemySnapshot const& snapshot = mapSnapshots.snapshots[i];
+        float reach = snapshot.radius - scanRange;
+        if (reach < 0.0f || snapshot.phaseMask != phaseMask)
+            continue;
+        
+        float dx = snapshot.centerX - x;
+        float dy = snapshot.centerY - y;
+        float dz = snapshot.centerZ - z;
+        if (dx * dx + dy * dy + dz * dz <= reach * reach)
+            return snapshot;
+    }
+    
+    if (mapSnapshots.used == mapSnapshots.snapshots.size())
+    {
+        mapSnapshots.snapshots.emplace_back();
+        EnemySnapshot& added = mapSnapshots.snapshots.back();
+        added.xs.reserve(ENEMY_SNAPSHOT_RESERVE);
+        added.ys.reserve(ENEMY_SNAPSHOT_RESERVE);
+        added.zs.reserve(ENEMY_SNAPSHOT_RESERVE);
+        added.units.reserve(ENEMY_SNAPSHOT_RESERVE);
+    }
+    
+    EnemySnapshot& snapshot = mapSnapshots.snapshots[mapSnapshots.used++];
+    snapshot.centerX = x;
+    snapshot.centerY = y;
+    snapshot.centerZ = z;
+    snapshot.phaseMask = phaseMask;
+    snapshot.radius = scanRange + ENEMY_SNAPSHOT_SHARE_DISTANCE;
+    snapshot.xs.clear();
+    snapshot.ys.clear();
+    snapshot.zs.clear();
+    snapshot.units.clear();
+    
+    EnemySnapshotSearcher searcher(caster, snapshot);
+    Cell::VisitAllObjects(caster, searcher, snapshot.radius);
+    
+    return snapshot;
+}
+
+// Appends the snapshot's units within 'scanRange' of (x, y, z) that are still alive to 'units'
+void CollectSnapshotUnits(EnemySnapshot const& snapshot, float x, float y, float z, float scanRange, std::vector<Unit*>& units)
+{
+    float rangeSq = scanRange * scanRange;
+    for (size_t i = 0; i < snapshot.units.size(); ++i)
+    {
+        float dx = snapshot.xs[i] - x;
+        float dy = snapshot.ys[i] - y;
+        float dz = snapshot.zs[i] - z;
+        if (dx * dx + dy * dy + dz * dz > rangeSq)
+            continue;
+        
+        // Earlier casts this tick may have killed it
+        Unit* unit = snapshot.units[i];
+        if (unit->IsAlive())
+            units.push_back(unit);
+    }
+}
+
+// Appends the units of 'units' that 'caster' is fighting to 'targets'. Returns the caster's
+// current target if it is an enemy within 'scanRange' that 'units' lacks: idle units are in
+// no snapshot, so the caller adds it after whatever checks 'units' went through.
+Unit* FilterCombatTargets(Unit* caster, float scanRange, std::vector<Unit*> const& units, std::vector<Unit*>& targets)
+{
+    // Players aim through their selection and pet; creatures and bots at their victim
+    Player* player = caster->ToPlayer();
+    Unit* selected = player ? player->GetSelectedUnit() : caster->GetVictim();
+    Pet* pet = player ? player->GetPet() : nullptr;
+    bool selectedFound = false;
+    
+    for (Unit* unit : units)
+    {
+        if (unit == caster || caster->IsFriendlyTo(unit))
+            continue;
+            
+        // Only include targets that are:
+        // 1. Already in combat with the caster
+        // 2. The caster's current target
+        // 3. Currently attacking the caster or caster's pet
+        bool isValidTarget = false;
+        
+        // Check if unit is in combat with caster
+        if (unit->IsInCombatWith(caster))
+        {
+            isValidTarget = true;
+        }
+        // Check if unit is the current target
+        else if (unit == selected)
+        {
+            isValidTarget = true;
+        }
+        // Check if unit is attacking caster or caster's pet
+        else if (unit->GetVictim() && 
+                (unit->GetVictim() == caster || (pet && unit->GetVictim() == pet)))
+        {
+            isValidTarget = true;
+        }
+        
+        if (isValidTarget)
+        {
+            selectedFound |= unit == selected;
+            targets.push_back(unit);
+        }
+    }
+    
+    if (selected && !selectedFound && selected != caster && selected->IsAlive() && !selected->HasUnitFlag(UNIT_FLAG_NOT_SELECTABLE)
+        && selected->IsWithinDistInMap(caster, scanRange) && !caster->IsFriendlyTo(selected))
+        return selected;
+    
+    return nullptr;
+}
+
+// Area scan: every unit within range, filtered down to the combat-relevant ones
+void FindCombatTargetsInArea(Unit* caster, float scanRange, std::vector<Unit*>& allTargets)
+{
+    static thread_local std::vector<Unit*> units;
+    units.clear();
+    
+    // Engaged units within reasonable range, from the snapshot shared with nearby casters
+    EnemySnapshot const& snapshot = GetEnemySnapshot(caster, scanRange);
+    CollectSnapshotUnits(snapshot, caster->GetPositionX(), caster->GetPositionY(), caster->GetPositionZ(), scanRange, units);
+    
+    if (Unit* idleTarget = FilterCombatTargets(caster, scanRange, units, allTargets))
+        allTargets.push_back(idleTarget);
+}
+
+// Adds every unit on the threat and attacker lists of 'owner'
+void CollectEngagedUnits(Unit* owner, std::vector<Unit*>& units)
+{
+    // Creatures holding 'owner' on their threat list
+    for (HostileReference* ref = owner->getHostileRefMgr().getFirst(); ref; ref = ref->next())
+        units.push_back(ref->GetSource()->GetOwner());
+    
+    // Anything with 'owner' as its victim, hostile players included
+    for (Unit* attacker : owner->getAttackers())
+        units.push_back(attacker);
+}
+
+// Combat references: exactly the units the area scan would keep, read from the lists the
+// core already maintains, so the cost follows the number of engaged enemies, not how crowded
+// the area is
+void FindEngagedTargets(Player* player, float scanRange, std::vector<Unit*>& allTargets)
+{
+    CollectEngagedUnits(player, allTargets);
+    if (Pet* pet = player->GetPet())
+        CollectEngagedUnits(pet, allTargets);
+    
+    if (Unit* selected = player->GetSelectedUnit())
+        allTargets.push_back(selected);
+    
+    // A unit is usually on several of these lists
+    std::sort(allTargets.begin(), allTargets.end());
+    allTargets.erase(std::unique(allTargets.begin(), allTargets.end()), allTargets.end());
+    
+    std::erase_if(allTargets, [player, scanRange](Unit* unit)
+    {
+        return unit == player || !unit->IsAlive() || unit->HasUnitFlag(UNIT_FLAG_NOT_SELECTABLE)
+            || !unit->IsWithinDistInMap(player, scanRange) || player->IsFriendlyTo(unit);
+    });
+}
+
+// Appends the candidate enemies of 'player' within 'scanRange' to 'targets'
+void FindCombatTargets(Player* player, float scanRange, std::vector<Unit*>& targets)
+{
+    PlacementStageTimer timer(PLACEMENT_STAGE_CANDIDATES);
+    
+    if (GetModuleConfig().candidateSource == CANDIDATE_SOURCE_AREA_SCAN)
+        FindCombatTargetsInArea(player, scanRange, targets);
+    else
+        FindEngagedTargets(player, scanRange, targets);
+}
+
+// Opt-in capture of placement queries for tools/PlacementReplay.cpp; started and stopped by
+// config loads on the world thread, fed from the map threads
+static PlacementTraceWriter placementTrace;
+static std::atomic<bool> placementTraceEnabled{ false };
+
+void StartPlacementTrace(EnhancedGroundTargetingConfig const& config)
+{
+    if (!config.traceEnabled)
+    {
+        placementTraceEnabled.store(false, std::memory_order_relaxed);
+        placementTrace.Stop();
+        return;
+    }
+
+    // A reload with unchanged settings keeps the running trace instead of rotating it
+    if (!placementTrace.Start(config.traceFile, uint64(config.traceMaxFileSize) * 1024 * 1024, config.traceMaxFiles))
+    {
+        placementTraceEnabled.store(false, std::memory_order_relaxed);
+        LOG_ERROR("module", "Enhanced Ground Targeting: cannot open trace file {}", config.traceFile);
+        return;
+    }
+
+    if (!placementTraceEnabled.exchange(true, std::memory_order_relaxed))
+        LOG_INFO("server.loading", "Enhanced Ground Targeting: tracing placements to {}", config.traceFile);
+}
+
+// Enemies a placement was computed from, kept so a cast can re-check them later
+struct PlacementCandidates
+{
+    std::vector<ObjectGuid> guids;
+    std::vector<PlacementPoint> points;
+};
+
+// Charges the scan and the line of sight queries to 'budget'
+void CollectPlacementCandidates(Player* player, SpellGeometry const& geometry, PlacementCandidates& candidates, PlacementBudget& budget)
+{
+    // Reused by every placement of this thread, like the candidate buffers themselves
+    static thread_local std::vector<Unit*> targets;
+    targets.clear();
+    
+    auto start = std::chrono::steady_clock::now();
+    FindCombatTargets(player, GetCandidateScanRange(geometry), targets);
+    ChargePlacementBudget(budget, start);
+    
+    candidates.guids.clear();
+    candidates.points.clear();
+    for (Unit* unit : targets)
+    {
+        if (!IsInPlacementLineOfSight(player, geometry, unit->GetPositionX(), unit->GetPositionY(), unit->GetPositionZ(), &budget))
+        {
+            AddPlacementCounter(PLACEMENT_COUNTER_OCCLUDED);
+            continue;
+        }
+        
+        candidates.guids.push_back(unit->GetGUID());
+        candidates.points.push_back({ unit->GetPositionX(), unit->GetPositionY() });
+    }
+}
+
+// Runs the engine on a collected candidate set, tracing the query if enabled
+AOEPosition SolvePlacement(Unit* caster, uint32 spellId, SpellGeometry const& geometry, std::vector<PlacementPoint> const& points, PlacementSolver solver)
+{
+    if (points.empty())
+        return AOEPosition();
+    
+    CasterPlacementWorldQuery world(caster);
+    AOEPosition position = CalculateOptimalAOEPosition(world, points, geometry.radius, geometry.maxRange, solver);
+    
+    if (placementTraceEnabled.load(std::memory_order_relaxed))
+    {
+        PlacementTraceRecord record;
+        record.timestampMs = uint64(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+        record.spellId = spellId;
+        record.solver = solver;
+        record.aoeRadius = geometry.radius;
+        record.maxRange = geometry.maxRange;
+        record.caster = world.GetCasterPosition();
+        record.points = points;
+        record.chosen = { position.x, position.y, position.z };
+        record.targetCount = position.targetCount;
+        placementTrace.Submit(std::move(record));
+    }
+    
+    return position;
+}
+
+// The configured solver, or the density map once a fight is too large for pairwise methods
+PlacementSolver SelectPlacementSolver(size_t candidates)
+{
+    EnhancedGroundTargetingConfig const& config = GetModuleConfig();
+    if (config.densityMapThreshold && candidates >= config.densityMapThreshold)
+        return PLACEMENT_SOLVER_DENSITY_MAP;
+    
+    return config.placementSolver;
+}
+
+// Cost model for the tick budget: moving average of each solver's time per cost unit. The
+// coverage search is charged per candidate squared, its dense worst case; the density map
+// per candidate plus map cell; the cluster solver per candidate times the neighbours it
+// visits, plus a fixed share per candidate for building its grid. Learnt per thread from the
+// placements it ran; until a solver has run once, a pessimistic seed stands in, so the first
+// large fight of a thread is not solved on a free pass.
+static thread_local double solverCostPerUnit[MAX_PLACEMENT_SOLVERS] = { 0.5, 60.0, 4.0 };
+static thread_local bool solverCostMeasured[MAX_PLACEMENT_SOLVERS] = { };
+static constexpr double SOLVER_COST_SMOOTHING = 0.2;
+
+// Cluster solver work per candidate beyond its neighbour visits, in neighbour visits
+static constexpr double CLUSTER_COST_CANDIDATE_OVERHEAD = 256.0;
+
+// Neighbours the cluster solver visits per candidate: those in the 3x3 block of 2r cells
+// around it, estimated from the candidates' density over their bounding box
+double EstimateClusterNeighbours(std::vector<PlacementPoint> const& points, float radius)
+{
+    if (points.empty())
+        return 0.0;
+    
+    float minX = points[0].x, maxX = points[0].x;
+    float minY = points[0].y, maxY = points[0].y;
+    for (PlacementPoint const& point : points)
+    {
+        minX = std::min(minX, point.x);
+        maxX = std::max(maxX, point.x);
+        minY = std::min(minY, point.y);
+        maxY = std::max(maxY, point.y);
+    }
+    
+    double cell = 2.0 * radius;
+    double block = 9.0 * cell * cell;
+    double area = std::max(double(maxX - minX + cell) * double(maxY - minY + cell), block);
+    return std::min(double(points.size()), double(points.size()) * block / area);
+}
+
+static double SolverCostUnits(PlacementSolver solver, size_t candidates, double neighbours)
+{
+    double n = double(std::max<size_t>(candidates, 1));
+    switch (solver)
+    {
+        case PLACEMENT_SOLVER_MAX_COVERAGE:
+            return n * n;
+        case PLACEMENT_SOLVER_DENSITY_MAP:
+            return n + double(PLACEMENT_DENSITY_MAP_CELLS) * PLACEMENT_DENSITY_MAP_CELLS;
+        default:
+            return n * (CLUSTER_COST_CANDIDATE_OVERHEAD + neighbours);
+    }
+}
+
+uint64 EstimateSolverCost(PlacementSolver solver, size_t candidates, double neighbours)
+{
+    return uint64(solverCostPerUnit[solver] * SolverCostUnits(solver, candidates, neighbours));
+}
+
+void RecordSolverCost(PlacementSolver solver, size_t candidates, double neighbours, uint64 ns)
+{
+    double& costPerUnit = solverCostPerUnit[solver];
+    double sample = double(ns) / SolverCostUnits(solver, candidates, neighbours);
+    costPerUnit = solverCostMeasured[solver] ? costPerUnit + SOLVER_COST_SMOOTHING * (sample - costPerUnit) : sample;
+    solverCostMeasured[solver] = true;
+}
+
+// Solvers to step down to when the selected one does not fit the budget, best results first
+static PlacementSolver const budgetFallbackSolvers[] = { PLACEMENT_SOLVER_DENSITY_MAP, PLACEMENT_SOLVER_CLUSTER_CENTER };
+
+// Runs the best solver the budget affords on the collected candidates. Over budget the
+// selected solver gives way to the best solver that is estimated both cheaper and within
+// the budget; if there is none nothing runs and the result is invalid.
+AOEPosition SolvePlacementWithinBudget(Unit* caster, uint32 spellId, SpellGeometry const& geometry,
+    std::vector<PlacementPoint> const& points, PlacementBudget& budget)
+{
+    double neighbours = EstimateClusterNeighbours(points, geometry.radius);
+    PlacementSolver solver = SelectPlacementSolver(points.size());
+    uint64 cost = EstimateSolverCost(solver, points.size(), neighbours);
+    if (!budget.Affords(cost))
+    {
+        PlacementSolver selected = solver;
+        for (PlacementSolver fallback : budgetFallbackSolvers)
+        {
+            uint64 fallbackCost = EstimateSolverCost(fallback, points.size(), neighbours);
+            if (fallbackCost < cost && budget.Affords(fallbackCost))
+            {
+                solver = fallback;
+                break;
+            }
+        }
+        
+        if (solver == selected)
+            return AOEPosition();
+        
+        AddPlacementCounter(PLACEMENT_COUNTER_DEGRADED_SOLVER);
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    AOEPosition position = SolvePlacement(caster, spellId, geometry, points, solver);
+    
+    uint64 ns = uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    RecordSolverCost(solver, points.size(), neighbours, ns);
+    budget.context.spentNs += ns;
+    return position;
+}
+
+struct PlacementStrategy;
+
+// Destination chosen for one cast. The first hook of a cast computes it and every later hook
+// reuses it, so a cast pays for one enemy scan and one solver pass instead of one per hook.
+struct CastPlacement
+{
+    Spell const* spell = nullptr;
+    uint32 spellId = 0;
+    uint32 computedAt = 0;
+    float casterX = 0.0f;
+    float casterY = 0.0f;
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    uint32 targetCount = 0;
+    
+    // Set for placements on an enemy cluster, which the cast may refresh when it completes
+    bool smart = false;
+    SpellGeometry geometry = {};
+    PlacementStrategy const* strategy = nullptr;
+    PlacementCandidates candidates;
+};
+
+// Longest a placement is trusted for; covers the longest registered cast time plus pushback
+static constexpr uint32 CAST_PLACEMENT_MAX_AGE = 10000;
+
+// Over budget, a previous cast's placement stands in for a new one for this long
+static constexpr uint32 DEGRADED_PLACEMENT_MAX_AGE = 3000;
+
+// Module state attached to each player through Player::CustomData. Only the map thread
+// updating the player touches it, so it needs no lock, and it is destroyed with the Player
+// object on logout.
+class EnhancedGroundTargetingPlayerData : public DataMap::Base
+{
+public:
+    bool toggleEnabled = false; // .toggle, disabled until the player turns it on
+    bool toggleChanged = false; // toggled this session; the stored value must not overwrite it
+    CastPlacement castPlacement;
+};
+
+// Built once: a key literal would become a heap-allocated std::string on every lookup
+static std::string const PLAYER_DATA_KEY = "EnhancedGroundTargeting";
+
+EnhancedGroundTargetingPlayerData* GetPlayerData(Player* player)
+{
+    return player->CustomData.GetDefault<EnhancedGroundTargetingPlayerData>(PLAYER_DATA_KEY);
+}
+
+// Helper functions for player toggle state
+bool GetPlayerToggleState(Player* player)
+{
+    // Players who never toggled have no data yet; don't create it on every cast of theirs
+    EnhancedGroundTargetingPlayerData const* data = player->CustomData.Get<EnhancedGroundTargetingPlayerData>(PLAYER_DATA_KEY);
+    return data && data->toggleEnabled;
+}
+
+void SetPlayerToggleState(Player* player, bool enabled)
+{
+    GetPlayerData(player)->toggleEnabled = enabled;
+}
+
+// Toggle changes waiting to be written to the character database. Commands only append here;
+// the WorldScript flushes the queue as one asynchronous transaction every few seconds.
+struct PendingToggleWrite
+{
+    uint32 guid;
+    bool enabled;
+};
+
+static std::vector<PendingToggleWrite> pendingToggleWrites;
+static std::mutex pendingToggleMutex;
+
+static constexpr uint32 TOGGLE_FLUSH_INTERVAL = 5000;
+
+// Sets the toggle and queues it to be saved
+void StorePlayerToggleState(Player* player, bool enabled)
+{
+    EnhancedGroundTargetingPlayerData* data = GetPlayerData(player);
+    data->toggleEnabled = enabled;
+    data->toggleChanged = true;
+    
+    std::lock_guard<std::mutex> lock(pendingToggleMutex);
+    pendingToggleWrites.push_back({ player->GetGUID().GetCounter(), enabled });
+}
+
+void FlushPendingToggleWrites()
+{
+    std::vector<PendingToggleWrite> writes;
+    {
+        std::lock_guard<std::mutex> lock(pendingToggleMutex);
+        writes.swap(pendingToggleWrites);
+    }
+    
+    if (writes.empty())
+        return;
+    
+    // Only the last change of each player is written
+    std::stable_sort(writes.begin(), writes.end(), [](PendingToggleWrite const& a, PendingToggleWrite const& b) { return a.guid < b.guid; });
+    
+    CharacterDatabaseTransaction trans = CharacterDatabase.BeginTransaction();
+    for (size_t i = 0; i < writes.size(); ++i)
+    {
+        if (i + 1 < writes.size() && writes[i + 1].guid == writes[i].guid)
+            continue;
+        
+        trans->Append("REPLACE INTO mod_enhanced_ground_targeting (guid, enabled) VALUES ({}, {})", writes[i].guid, writes[i].enabled ? 1 : 0);
+    }
+    
+    CharacterDatabase.CommitTransaction(trans);
+}
+
+// Reads the saved toggle without blocking; the result is applied when the session processes
+// its query callbacks, unless the player has toggled in the meantime
+void LoadPlayerToggleState(Player* player)
+{
+    WorldSession* session = player->GetSession();
+    ObjectGuid guid = player->GetGUID();
+    
+    session->GetQueryProcessor().AddCallback(CharacterDatabase.AsyncQuery(Acore::StringFormat("SELECT enabled FROM mod_enhanced_ground_targeting WHERE guid = {}", guid.GetCounter()))
+        .WithCallback([session, guid](QueryResult result)
+        {
+            Player* player = session->GetPlayer();
+            if (!result || !player || player->GetGUID() != guid)
+                return;
+            
+            EnhancedGroundTargetingPlayerData* data = GetPlayerData(player);
+            if (!data->toggleChanged)
+                data->toggleEnabled = (*result)[0].Get<uint8>() != 0;
+        }));
+}
+
+// Placement pipelines. A pipeline is composed of a candidate source, a solver and a
+// validation policy; each spell kind runs its own instantiation, picked from a table by the
+// kind classified at startup. The policies inline into the instantiation, so a cast makes
+// one indirect call and skips the steps its kind does not have without testing for them.
+
+// Candidate sources: the units a placement may cover
+struct EnemyCandidates
+{
+    static void Collect(Player* player, SpellGeometry const& geometry, PlacementCandidates& candidates, PlacementBudget& budget)
+    {
+        CollectPlacementCandidates(player, geometry, candidates, budget);
+    }
+};
+
+struct NoCandidates
+{
+    static void Collect(Player* /*player*/, SpellGeometry const& /*geometry*/, PlacementCandidates& /*candidates*/, PlacementBudget& /*budget*/) { }
+};
+
+// Solvers: return true once they have placed the cast
+struct BudgetedSolver
+{
+    // The best cluster this map's tick budget affords, if it holds enough enemies. Out of
+    // budget, the player's previous smart placement stands in while it still applies.
+    template<class Candidates>
+    static bool Place(Player* player, CastPlacement& placement, CastPlacement const& previous)
+    {
+        SpellGeometry const& geometry = placement.geometry;
+        PlacementBudget budget = GetPlacementBudget(player);
+        AOEPosition optimalPos;
+        bool degraded = budget.Exhausted();
+        
+        if (!degraded)
+        {
+            Candidates::Collect(player, geometry, placement.candidates, budget);
+            
+            optimalPos = SolvePlacementWithinBudget(player, placement.spellId, geometry, placement.candidates.points, budget);
+            degraded = !optimalPos.isValid && !placement.candidates.points.empty();
+        }
+        
+        if (degraded)
+        {
+            bool reusable = previous.smart
+                && getMSTimeDiff(previous.computedAt, getMSTime()) <= DEGRADED_PLACEMENT_MAX_AGE
+                && player->GetExactDist2dSq(previous.casterX, previous.casterY) <= 1.0f
+                && player->GetExactDist2dSq(previous.x, previous.y) <= geometry.maxRange * geometry.maxRange;
+            
+            if (reusable)
+            {
+                placement.x = previous.x;
+                placement.y = previous.y;
+                placement.z = previous.z;
+                placement.targetCount = previous.targetCount;
+                AddPlacementCounter(PLACEMENT_COUNTER_DEGRADED_CACHED);
+                return true;
+            }
+            
+            AddPlacementCounter(PLACEMENT_COUNTER_DEGRADED_TARGET);
+        }
+        
+        // The candidates are all visible, but the center between them may still sit behind a pillar
+        if (!optimalPos.isValid || optimalPos.targetCount < GetModuleConfig().minEnemiesForSmart
+            || !IsInPlacementLineOfSight(player, geometry, optimalPos.x, optimalPos.y, optimalPos.z))
+            return false;
+        
+        placement.x = optimalPos.x;
+        placement.y = optimalPos.y;
+        placement.z = optimalPos.z;
+        placement.targetCount = optimalPos.targetCount;
+        placement.smart = true;
+        
+        AddPlacementCounter(PLACEMENT_COUNTER_SMART);
+        RecordClusterSize(optimalPos.targetCount);
+        return true;
+    }
+};
+
+struct NoSolver
+{
+    template<class Candidates>
+    static bool Place(Player* /*player*/, CastPlacement& /*placement*/, CastPlacement const& /*previous*/)
+    {
+        return false;
+    }
+};
+
+// Validation: where an unsolved cast goes, kept in range and on the ground
+void PlaceOnAnchor(Player* player, CastPlacement& placement, Unit* target)
+{
+    WorldObject* anchor = target ? static_cast<WorldObject*>(target) : player;
+    
+    placement.x = anchor->GetPositionX();
+    placement.y = anchor->GetPositionY();
+    placement.z = anchor->GetPositionZ();
+    placement.targetCount = target ? 1 : 0;
+    
+    AddPlacementCounter(target ? PLACEMENT_COUNTER_FALLBACK_TARGET : PLACEMENT_COUNTER_FALLBACK_SELF);
+    ValidateAndAdjustPosition(player, placement.x, placement.y, placement.z, placement.geometry);
+}
+
+// The selected unit if the player can see it, otherwise the player
+struct ValidateOnTarget
+{
+    static void Place(Player* player, CastPlacement& placement)
+    {
+        Unit* target = player->GetSelectedUnit();
+        if (target && !IsInPlacementLineOfSight(player, placement.geometry, target->GetPositionX(), target->GetPositionY(), target->GetPositionZ()))
+            target = nullptr;
+        
+        PlaceOnAnchor(player, placement, target);
+    }
+};
 
-// Player-specific toggle storage
-static std::unordered_map<uint64, bool> playerToggleState;
-static std::mutex toggleMutex;
+struct ValidateOnCaster
+{
+    static void Place(Player* player, CastPlacement& placement)
+    {
+        PlaceOnAnchor(player, placement, nullptr);
+    }
+};
 
-// Helper functions for player toggle state
-bool GetPlayerToggleState(uint64 playerGuid)
+template<class Candidates, class Solver, class Validation>
+struct PlacementPipeline
+{
+    static void Compute(Player* player, CastPlacement& placement, CastPlacement const& previous)
+    {
+        if (!Solver::template Place<Candidates>(player, placement, previous))
+            Validation::Place(player, placement);
+    }
+};
+
+using AreaPlacementPipeline = PlacementPipeline<EnemyCandidates, BudgetedSolver, ValidateOnTarget>;
+using TargetPlacementPipeline = PlacementPipeline<NoCandidates, NoSolver, ValidateOnTarget>;
+using CasterPlacementPipeline = PlacementPipeline<NoCandidates, NoSolver, ValidateOnCaster>;
+
+// One pipeline per spell kind, and whether the cast re-scores its placement as it completes
+struct PlacementStrategy
+{
+    void (*compute)(Player* player, CastPlacement& placement, CastPlacement const& previous);
+    bool refreshAtCastEnd;
+};
+
+// Indexed by [SmartPositioning][PlacementKind]; without smart positioning AoE goes on the target
+static PlacementStrategy const placementStrategies[2][MAX_PLACEMENT_KINDS] =
+{
+    {
+        { &TargetPlacementPipeline::Compute, false }, // PLACEMENT_KIND_AREA
+        { &TargetPlacementPipeline::Compute, false }, // PLACEMENT_KIND_CHANNELED_AREA
+        { &CasterPlacementPipeline::Compute, false }, // PLACEMENT_KIND_SUMMON
+        { &TargetPlacementPipeline::Compute, false }  // PLACEMENT_KIND_DISTRACT
+    },
+    {
+        { &AreaPlacementPipeline::Compute, true },    // PLACEMENT_KIND_AREA
+        { &AreaPlacementPipeline::Compute, false },   // PLACEMENT_KIND_CHANNELED_AREA: nothing moves before the channel starts
+        { &CasterPlacementPipeline::Compute, false }, // PLACEMENT_KIND_SUMMON
+        { &TargetPlacementPipeline::Compute, false }  // PLACEMENT_KIND_DISTRACT
+    }
+};
+
+// Runs the spell's pipeline into 'placement'. 'previous' is the player's last placement,
+// which an over-budget pipeline may reuse.
+void ComputePlacement(Player* player, SpellInfo const* spellInfo, CastPlacement& placement, CastPlacement const& previous)
 {
-    std::lock_guard<std::mutex> lock(toggleMutex);
-    auto it = playerToggleState.find(playerGuid);
-    return it != playerToggleState.end() ? it->second : false; // Default to disabled
+    placement.spellId = spellInfo->Id;
+    placement.computedAt = getMSTime();
+    placement.casterX = player->GetPositionX();
+    placement.casterY = player->GetPositionY();
+    placement.geometry = GetSpellGeometry(spellInfo);
+    placement.strategy = &placementStrategies[GetModuleConfig().smartPositioning][placement.geometry.kind];
+    placement.strategy->compute(player, placement, previous);
+}
+
+CastPlacement ComputeCastPlacement(Player* player, Spell const* spell)
+{
+    // Collect into the buffers of the placement this one replaces, so a steady stream of
+    // casts keeps reusing the same candidate storage instead of allocating it every time
+    CastPlacement& previous = GetPlayerData(player)->castPlacement;
+    CastPlacement placement;
+    std::swap(placement.candidates, previous.candidates);
+    placement.spell = spell;
+    
+    ComputePlacement(player, spell->GetSpellInfo(), placement, previous);
+    return placement;
 }
 
-void SetPlayerToggleState(uint64 playerGuid, bool enabled)
+// Computes the placement of a cast that is just starting. The Spell of a finished cast is
+// often freed and handed back at the same address for the next one, so a new cast must
+// never be matched against the stored placement; the first hook always comes through here.
+CastPlacement const& StartCastPlacement(Player* player, Spell const* spell)
 {
-    std::lock_guard<std::mutex> lock(toggleMutex);
-    playerToggleState[playerGuid] = enabled;
+    CastPlacement& placement = GetPlayerData(player)->castPlacement;
+    placement = ComputeCastPlacement(player, spell);
+    return placement;
 }
 
-// Structure to hold AOE position data
-struct AOEPosition
+// Returns this cast's placement, computing it only if no earlier hook of the same cast did
+CastPlacement const& ResolveCastPlacement(Player* player, Spell const* spell)
 {
-    float x, y, z;
-    uint32 targetCount;
-    bool isValid;
+    EnhancedGroundTargetingPlayerData* data = GetPlayerData(player);
+    CastPlacement& placement = data->castPlacement;
     
-    AOEPosition() : x(0.0f), y(0.0f), z(0.0f), targetCount(0), isValid(false) {}
-    AOEPosition(float _x, float _y, float _z, uint32 _count) : x(_x), y(_y), z(_z), targetCount(_count), isValid(true) {}
-};
+    // Cheap validity check: same cast, recent, and the caster has not walked away from it
+    bool reusable = placement.spell == spell
+        && placement.spellId == spell->GetSpellInfo()->Id
+        && getMSTimeDiff(placement.computedAt, getMSTime()) <= CAST_PLACEMENT_MAX_AGE
+        && player->GetExactDist2dSq(placement.casterX, placement.casterY) <= 1.0f;
+    
+    if (!reusable)
+        placement = ComputeCastPlacement(player, spell);
+    else
+        AddPlacementCounter(PLACEMENT_COUNTER_REUSED);
+    
+    return placement;
+}
 
-// AzerothCore-style position validation (based on SpellEffects.cpp research)
-bool ValidateAndAdjustPosition(Player* player, float& x, float& y, float& z, SpellInfo const* spellInfo)
+// Enemies closer than this to where the placement saw them are not re-scored
+static constexpr float CAST_REFRESH_MOVE_THRESHOLD = 2.0f;
+
+// Brings a placement computed when the cast started up to date as the cast completes. Only
+// candidates that moved past the threshold, died or left are re-scored against the chosen
+// center; the candidates are solved again, without a new scan, only if that center lost
+// enemies. Units that joined the fight during the cast are not picked up.
+CastPlacement const& RefreshCastPlacement(Player* player, Spell const* spell)
 {
-    if (!player || !spellInfo)
-        return false;
+    CastPlacement& placement = GetPlayerData(player)->castPlacement;
+    bool fresh = placement.spell != spell;
     
-    float originalX = x, originalY = y, originalZ = z;
-    float maxRange = spellInfo->GetMaxRange(false);
+    ResolveCastPlacement(player, spell);
+    if (fresh || !placement.smart || !placement.strategy->refreshAtCastEnd || placement.computedAt == getMSTime())
+        return placement;
     
-    // Phase 1: AzerothCore 6-yard Z-difference rule (SpellEffects.cpp:2502-2503)
-    if (std::fabs(player->GetPositionZ() - z) > 6.0f)
+    float radiusSq = (placement.geometry.radius + 0.001f) * (placement.geometry.radius + 0.001f);
+    float thresholdSq = CAST_REFRESH_MOVE_THRESHOLD * CAST_REFRESH_MOVE_THRESHOLD;
+    auto covered = [&](PlacementPoint const& point)
     {
-        z = player->GetPositionZ(); // Adjust Z like AzerothCore does
-    }
+        float dx = point.x - placement.x;
+        float dy = point.y - placement.y;
+        return dx * dx + dy * dy <= radiusSq;
+    };
     
-    // Update ground position using AzerothCore method
-    player->UpdateAllowedPositionZ(x, y, z);
+    std::vector<ObjectGuid>& guids = placement.candidates.guids;
+    std::vector<PlacementPoint>& points = placement.candidates.points;
     
-    // Check basic range constraint
-    float distanceToPlayer = player->GetExactDist2d(x, y);
-    if (maxRange > 0 && distanceToPlayer <= maxRange)
+    bool changed = false;
+    int32 hits = int32(placement.targetCount);
+    for (size_t i = 0; i < guids.size();)
     {
-        return true; // Position valid - AzerothCore style (no LoS check)
+        Unit* unit = ObjectAccessor::GetUnit(*player, guids[i]);
+        if (!unit || !unit->IsAlive())
+        {
+            hits -= covered(points[i]);
+            guids[i] = guids.back();
+            points[i] = points.back();
+            guids.pop_back();
+            points.pop_back();
+            changed = true;
+            continue;
+        }
+        
+        PlacementPoint now = { unit->GetPositionX(), unit->GetPositionY() };
+        float dx = now.x - points[i].x;
+        float dy = now.y - points[i].y;
+        if (dx * dx + dy * dy > thresholdSq)
+        {
+            hits += int32(covered(now)) - int32(covered(points[i]));
+            points[i] = now;
+            changed = true;
+        }
+        
+        ++i;
     }
     
-    // Phase 2: Use AzerothCore's GetRandomPoint method (SpellEffects.cpp:2467, 6049)
-    float searchRadius = maxRange > 0 ? std::min(8.0f, maxRange * 0.3f) : 8.0f;
-    Position originalPos(originalX, originalY, originalZ);
-    Position randomPos = player->GetRandomPoint(originalPos, searchRadius);
+    if (!changed)
+        return placement;
     
-    // AzerothCore automatically handles ground height in GetRandomPoint
-    x = randomPos.GetPositionX();
-    y = randomPos.GetPositionY(); 
-    z = randomPos.GetPositionZ();
+    AddPlacementCounter(PLACEMENT_COUNTER_REFRESHED);
+    if (hits >= int32(placement.targetCount))
+    {
+        placement.targetCount = uint32(hits);
+        return placement;
+    }
     
-    // Check range constraint for random position
-    distanceToPlayer = player->GetExactDist2d(x, y);
-    if (maxRange <= 0 || distanceToPlayer <= maxRange)
+    PlacementBudget budget = GetPlacementBudget(player);
+    AOEPosition optimalPos = SolvePlacementWithinBudget(player, placement.spellId, placement.geometry, points, budget);
+    if (optimalPos.isValid && optimalPos.targetCount > uint32(std::max(hits, 0))
+        && IsInPlacementLineOfSight(player, placement.geometry, optimalPos.x, optimalPos.y, optimalPos.z))
     {
-        return true; // Random position valid
+        placement.x = optimalPos.x;
+        placement.y = optimalPos.y;
+        placement.z = optimalPos.z;
+        placement.targetCount = optimalPos.targetCount;
+        AddPlacementCounter(PLACEMENT_COUNTER_RESOLVED);
     }
+    else
+        placement.targetCount = uint32(std::max(hits, 0));
     
-    // Phase 3: No valid position found - let spell fail naturally
-    return false;
+    return placement;
 }
 
-// Find maximum density cluster of enemies (based on playerbot algorithm)
-std::vector<Unit*> FindMaxDensity(Player* player, float aoeRadius = 8.0f)
+// Batch requests that share their candidate filtering: casters in one line of sight cell
+// aiming spells of the same reach, radius and sight rule. The snapshot units in reach and
+// sight of the cell are found once; each caster then only keeps the ones it is fighting,
+// and every distinct set of those is solved once.
+struct PlacementBatchSolve
 {
-    std::vector<Unit*> allTargets;
-    std::vector<Unit*> bestCluster;
-    
-    // Find all possible targets within reasonable range
-    std::list<Unit*> targets;
-    Acore::AnyUnfriendlyUnitInObjectRangeCheck u_check(player, player, 35.0f);
-    Acore::UnitListSearcher<Acore::AnyUnfriendlyUnitInObjectRangeCheck> searcher(player, targets, u_check);
-    Cell::VisitAllObjects(player, searcher, 35.0f);
-    
-    // Convert to vector and filter for combat-relevant targets only
-    for (Unit* unit : targets)
+    std::vector<Unit*> targets;
+    Unit* caster = nullptr; // whose reach and ground the position was solved for
+    AOEPosition position;
+};
+
+struct PlacementBatchGroup
+{
+    uint64 casterCell = 0;
+    SpellGeometry geometry = { };
+    std::vector<Unit*> units;
+    uint32 solvesUsed = 0;
+    std::vector<PlacementBatchSolve> solves; // [0, solvesUsed) belong to this batch
+};
+
+PlacementBatchGroup& GetPlacementBatchGroup(std::vector<PlacementBatchGroup>& groups, uint32& groupsUsed,
+    Unit* caster, SpellGeometry const& geometry, PlacementBudget& budget)
+{
+    uint64 cell = LineOfSightCache::CasterCell(caster->GetPositionX(), caster->GetPositionY(), caster->GetPositionZ());
+    for (uint32 i = 0; i < groupsUsed; ++i)
     {
-        if (!unit || !unit->IsAlive() || unit->HasUnitFlag(UNIT_FLAG_NOT_SELECTABLE))
-            continue;
-            
-        // Only include targets that are:
-        // 1. Already in combat with the player
-        // 2. The player's current target
-        // 3. Currently attacking the player or player's pet
-        bool isValidTarget = false;
-        
-        // Check if unit is in combat with player
-        if (unit->IsInCombatWith(player))
-        {
-            isValidTarget = true;
-        }
-        // Check if unit is the current target
-        else if (player->GetSelectedUnit() && player->GetSelectedUnit()->GetGUID() == unit->GetGUID())
-        {
-            isValidTarget = true;
-        }
-        // Check if unit is attacking player or player's pet
-        else if (unit->GetVictim() && 
-                (unit->GetVictim()->GetGUID() == player->GetGUID() || 
-                 (player->GetPet() && unit->GetVictim()->GetGUID() == player->GetPet()->GetGUID())))
-        {
-            isValidTarget = true;
-        }
-        
-        if (isValidTarget)
-        {
-            allTargets.push_back(unit);
-        }
+        PlacementBatchGroup& group = groups[i];
+        if (group.casterCell == cell && group.geometry.maxRange == geometry.maxRange && group.geometry.radius == geometry.radius
+            && group.geometry.lineOfSight == geometry.lineOfSight)
+            return group;
     }
     
-    if (allTargets.empty())
-        return bestCluster;
+    if (groupsUsed == groups.size())
+        groups.emplace_back();
     
-    std::map<Unit*, std::vector<Unit*>> groups;
-    uint32 maxCount = 0;
-    Unit* bestCenter = nullptr;
+    PlacementBatchGroup& group = groups[groupsUsed++];
+    group.casterCell = cell;
+    group.geometry = geometry;
+    group.units.clear();
+    group.solvesUsed = 0;
     
-    // For each potential target, count how many other targets are within AOE radius
-    for (Unit* unit : allTargets)
+    // Always the area scan: it is what lets nearby casters share one grid visit
+    float scanRange = GetCandidateScanRange(geometry);
+    auto start = std::chrono::steady_clock::now();
     {
-        for (Unit* other : allTargets)
-        {
-            float distance = unit->GetExactDist2d(other);
-            if (distance <= aoeRadius * 2.0f) // Use 2x radius for better clustering
-            {
-                groups[unit].push_back(other);
-            }
-        }
-        
-        if (groups[unit].size() > maxCount)
-        {
-            maxCount = groups[unit].size();
-            bestCenter = unit;
-        }
+        PlacementStageTimer timer(PLACEMENT_STAGE_CANDIDATES);
+        EnemySnapshot const& snapshot = GetEnemySnapshot(caster, scanRange);
+        CollectSnapshotUnits(snapshot, caster->GetPositionX(), caster->GetPositionY(), caster->GetPositionZ(), scanRange, group.units);
     }
+    ChargePlacementBudget(budget, start);
     
-    if (bestCenter && groups.find(bestCenter) != groups.end())
+    std::erase_if(group.units, [caster, &geometry, &budget](Unit* unit)
     {
-        bestCluster = groups[bestCenter];
-    }
+        if (IsInPlacementLineOfSight(caster, geometry, unit->GetPositionX(), unit->GetPositionY(), unit->GetPositionZ(), &budget))
+            return false;
+        
+        AddPlacementCounter(PLACEMENT_COUNTER_OCCLUDED);
+        return true;
+    });
     
-    return bestCluster;
+    return group;
 }
 
-// Calculate optimal AOE position based on playerbot algorithm with validation
-AOEPosition CalculateOptimalAOEPosition(Player* player, float aoeRadius = 8.0f, SpellInfo const* spellInfo = nullptr)
+void ComputeGroundPlacements(std::vector<GroundPlacementRequest> const& requests, std::vector<GroundPlacementResult>& results)
 {
-    std::vector<Unit*> cluster = FindMaxDensity(player, aoeRadius);
+    results.assign(requests.size(), GroundPlacementResult());
     
-    if (cluster.empty())
-        return AOEPosition();
-    
-    // Calculate bounding box of the cluster (playerbot method)
-    float x1 = 0.0f, y1 = 0.0f, x2 = 0.0f, y2 = 0.0f;
-    bool firstUnit = true;
+    // Shared by every batch of this thread; capacity is kept between batches
+    static thread_local std::vector<PlacementBatchGroup> groups;
+    static thread_local std::vector<Unit*> targets;
+    static thread_local std::vector<PlacementPoint> points;
+    uint32 groupsUsed = 0;
     
-    for (Unit* unit : cluster)
+    Map const* map = nullptr;
+    for (size_t i = 0; i < requests.size(); ++i)
     {
-        if (!unit)
+        Unit* caster = requests[i].caster;
+        SpellInfo const* spellInfo = sSpellMgr->GetSpellInfo(requests[i].spellId);
+        if (!caster || !caster->IsInWorld() || !spellInfo)
             continue;
-            
-        float unitX = unit->GetPositionX();
-        float unitY = unit->GetPositionY();
         
-        if (firstUnit)
-        {
-            x1 = x2 = unitX;
-            y1 = y2 = unitY;
-            firstUnit = false;
-        }
-        else
+        // The calling thread updates one map; units of any other may be moving under it
+        if (!map)
+            map = caster->GetMap();
+        ASSERT(caster->GetMap() == map, "ComputeGroundPlacements: all casters of a batch must be on the calling thread's map");
+        
+        SpellGeometry geometry = GetSpellGeometry(spellInfo);
+        PlacementBudget budget = GetPlacementBudget(caster);
+        if (budget.Exhausted())
+            continue;
+        
+        PlacementBatchGroup& group = GetPlacementBatchGroup(groups, groupsUsed, caster, geometry, budget);
+        
+        targets.clear();
+        if (Unit* idleTarget = FilterCombatTargets(caster, GetCandidateScanRange(geometry), group.units, targets))
+            if (IsInPlacementLineOfSight(caster, geometry, idleTarget->GetPositionX(), idleTarget->GetPositionY(), idleTarget->GetPositionZ(), &budget))
+                targets.push_back(idleTarget);
+        
+        PlacementBatchSolve* solve = nullptr;
+        for (uint32 j = 0; j < group.solvesUsed && !solve; ++j)
+            if (group.solves[j].targets == targets)
+                solve = &group.solves[j];
+        
+        if (!solve)
         {
-            if (unitX < x1) x1 = unitX;
-            if (unitX > x2) x2 = unitX;
-            if (unitY < y1) y1 = unitY;
-            if (unitY > y2) y2 = unitY;
+            points.clear();
+            for (Unit* unit : targets)
+                points.push_back({ unit->GetPositionX(), unit->GetPositionY() });
+            
+            if (group.solvesUsed == group.solves.size())
+                group.solves.emplace_back();
+            
+            solve = &group.solves[group.solvesUsed++];
+            solve->targets = targets;
+            solve->caster = caster;
+            solve->position = SolvePlacementWithinBudget(caster, spellInfo->Id, geometry, points, budget);
         }
+        
+        AOEPosition position = solve->position;
+        if (!position.isValid)
+            continue;
+        
+        // Casters sharing a cell stand up to a couple of yards apart
+        if (solve->caster != caster)
+            ValidateAndAdjustPosition(caster, position.x, position.y, position.z, geometry);
+        
+        if (!IsInPlacementLineOfSight(caster, geometry, position.x, position.y, position.z))
+            continue;
+        
+        GroundPlacementResult& result = results[i];
+        result.x = position.x;
+        result.y = position.y;
+        result.z = position.z;
+        result.predictedHits = position.targetCount;
+        result.isValid = true;
     }
     
-    // Calculate center point of bounding box
-    float centerX = (x1 + x2) / 2.0f;
-    float centerY = (y1 + y2) / 2.0f;
-    float centerZ = player->GetPositionZ();
+    AddPlacementCounter(PLACEMENT_COUNTER_BATCH, requests.size());
+}
+
+// The player whose cast the hooks should place, or null if the module leaves it alone
+Player* GetPlacingPlayer(Unit* caster)
+{
+    EnhancedGroundTargetingConfig const& config = GetModuleConfig();
+    if (!config.enabled || !config.autoTarget || !caster)
+        return nullptr;
     
-    // Use enhanced validation system instead of basic UpdateAllowedPositionZ
-    if (spellInfo && ValidateAndAdjustPosition(player, centerX, centerY, centerZ, spellInfo))
-    {
-        return AOEPosition(centerX, centerY, centerZ, cluster.size());
-    }
-    else
-    {
-        // Fallback: use basic method if enhanced validation fails
-        player->UpdateAllowedPositionZ(centerX, centerY, centerZ);
-        return AOEPosition(centerX, centerY, centerZ, cluster.size());
-    }
+    Player* player = caster->ToPlayer();
+    if (!player || !GetPlayerToggleState(player))
+        return nullptr;
+    
+    return player;
 }
 
 // This is the spell script for auto-targeting ground AoE spells
@@ -248,136 +1817,25 @@ public:
 
         void HandleBeforeCast()
         {
-            if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.AutoTarget", true))
+            // Bound by hand but left out of the table: not a destination spell
+            if (!IsRegisteredSpell(GetSpellInfo()->Id))
                 return;
 
-            Unit* caster = GetCaster();
-            if (!caster || !caster->ToPlayer())
-                return;
+            PlacementStageTimer timer(PLACEMENT_STAGE_HOOK);
 
-            Player* player = caster->ToPlayer();
-            
-            // Check if player has toggled off the feature
-            if (!GetPlayerToggleState(player->GetGUID().GetCounter()))
+            Player* player = GetPlacingPlayer(GetCaster());
+            if (!player)
                 return;
                 
             Spell* spell = GetSpell();
             if (!spell)
                 return;
                 
+            // The placement from the start of the cast, updated for enemies that moved since
+            CastPlacement const& placement = RefreshCastPlacement(player, spell);
             
-                
-            // Get spell info for AOE radius calculation
-            SpellInfo const* spellInfo = GetSpellInfo();
-            if (!spellInfo)
-                return;
-                
-            // Determine AOE radius based on spell (default to 8.0f for most spells)
-            float aoeRadius = 8.0f;
-            uint32 spellId = spellInfo->Id;
-            
-            // Specific radius adjustments for known spells
-            switch (spellId)
-            {
-                case 1510:  // Volley (Rank 1)
-                case 14294: // Volley (Rank 2)
-                case 14295: // Volley (Rank 3)
-                case 27022: // Volley (Rank 4)
-                case 58431: // Volley (Rank 5)
-                case 58432: // Volley (Rank 6)
-                    aoeRadius = 8.0f;
-                    break;
-                case 42208: // Blizzard (all ranks)
-                case 42209:
-                case 42210:
-                case 42211:
-                case 42212:
-                case 42213:
-                case 42214:
-                case 42215:
-                    aoeRadius = 8.0f;
-                    break;
-                case 5740:  // Rain of Fire (all ranks)
-                case 6219:
-                case 11677:
-                case 11678:
-                case 27212:
-                case 47819:
-                case 47820:
-                    aoeRadius = 8.0f;
-                    break;
-                case 43265: // Death and Decay
-                    aoeRadius = 8.0f;
-                    break;
-                default:
-                    aoeRadius = 8.0f; // Default radius for unknown spells
-                    break;
-            }
-            
-            float targetX, targetY, targetZ;
-            bool useOptimalPosition = false;
-            
-            // Check if smart positioning is enabled
-            bool smartEnabled = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.SmartPositioning", true);
-            uint32 minEnemies = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.MinEnemiesForSmart", 2);
-            
-            if (smartEnabled)
-            {
-                // Try to calculate optimal AOE position
-                AOEPosition optimalPos = CalculateOptimalAOEPosition(player, aoeRadius, spellInfo);
-                
-                if (optimalPos.isValid && optimalPos.targetCount >= minEnemies)
-                {
-                    // Use optimal position if we found a good cluster
-                    targetX = optimalPos.x;
-                    targetY = optimalPos.y;
-                    targetZ = optimalPos.z;
-                    useOptimalPosition = true;
-                }
-                else
-                {
-                    // Fallback to current target position
-                    Unit* target = player->GetSelectedUnit();
-                    if (target)
-                    {
-                        targetX = target->GetPositionX();
-                        targetY = target->GetPositionY();
-                        targetZ = target->GetPositionZ();
-                        
-                        ValidateAndAdjustPosition(player, targetX, targetY, targetZ, spellInfo);
-                    }
-                    else
-                    {
-                        targetX = player->GetPositionX();
-                        targetY = player->GetPositionY();
-                        targetZ = player->GetPositionZ();
-                        
-                        ValidateAndAdjustPosition(player, targetX, targetY, targetZ, spellInfo);
-                    }
-                }
-            }
-            else
-            {
-                Unit* target = player->GetSelectedUnit();
-                if (target)
-                {
-                    targetX = target->GetPositionX();
-                    targetY = target->GetPositionY();
-                    targetZ = target->GetPositionZ();
-                    
-                    ValidateAndAdjustPosition(player, targetX, targetY, targetZ, spellInfo);
-                }
-                else
-                {
-                    targetX = player->GetPositionX();
-                    targetY = player->GetPositionY();
-                    targetZ = player->GetPositionZ();
-                    
-                    ValidateAndAdjustPosition(player, targetX, targetY, targetZ, spellInfo);
-                }
-            }
             // Set spell destination
-            spell->m_targets.SetDst(targetX, targetY, targetZ, player->GetOrientation());
+            spell->m_targets.SetDst(placement.x, placement.y, placement.z, player->GetOrientation());
             
             uint32 targetFlags = spell->m_targets.GetTargetMask();
             targetFlags |= TARGET_FLAG_DEST_LOCATION;
@@ -398,17 +1856,13 @@ public:
         
         SpellCastResult HandleCheckCast()
         {
-            if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.AutoTarget", true))
+            if (!IsRegisteredSpell(GetSpellInfo()->Id))
                 return SPELL_CAST_OK;
 
-            Unit* caster = GetCaster();
-            if (!caster || !caster->ToPlayer())
-                return SPELL_CAST_OK;
+            PlacementStageTimer timer(PLACEMENT_STAGE_HOOK);
 
-            Player* player = caster->ToPlayer();
-            
-            // Check if player has toggled off the feature
-            if (!GetPlayerToggleState(player->GetGUID().GetCounter()))
+            Player* player = GetPlacingPlayer(GetCaster());
+            if (!player)
                 return SPELL_CAST_OK;
                 
             // Force a valid destination early to bypass cursor validation
@@ -425,27 +1879,10 @@ public:
             }
             
             // No valid destination, create one to prevent cursor errors
-            Unit* target = player->GetSelectedUnit();
-            float targetX, targetY, targetZ;
-            
-            if (target)
-            {
-                targetX = target->GetPositionX();
-                targetY = target->GetPositionY();
-                targetZ = target->GetPositionZ();
-            }
-            else
-            {
-                targetX = player->GetPositionX();
-                targetY = player->GetPositionY();
-                targetZ = player->GetPositionZ();
-            }
-            
-            // Ensure valid ground position
-            player->UpdateAllowedPositionZ(targetX, targetY, targetZ);
+            CastPlacement const& placement = ResolveCastPlacement(player, spell);
             
             // Set a temporary destination to prevent cursor validation errors
-            spell->m_targets.SetDst(targetX, targetY, targetZ, player->GetOrientation());
+            spell->m_targets.SetDst(placement.x, placement.y, placement.z, player->GetOrientation());
             spell->m_targets.SetTargetMask(spell->m_targets.GetTargetMask() | TARGET_FLAG_DEST_LOCATION);
             
             return SPELL_CAST_OK;
@@ -458,6 +1895,19 @@ public:
     }
 };
 
+// Appends the current stats, stamped with the time, to 'path'. World thread only.
+void DumpPlacementStats(std::string const& path)
+{
+    std::ofstream file(path, std::ios::app);
+    if (!file)
+    {
+        LOG_ERROR("module", "Enhanced Ground Targeting: cannot write stats to {}", path);
+        return;
+    }
+
+    file << "[" << Acore::Time::TimeToTimestampStr(GameTime::GetGameTime()) << "] " << FormatPlacementStats() << "\n";
+}
+
 // Main class for the module
 class EnhancedGroundTargeting : public WorldScript
 {
@@ -466,34 +1916,61 @@ public:
 
     void OnAfterConfigLoad(bool /*reload*/) override
     {
-        // Load configuration options
-        enabled = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Enable", true);
-        autoTarget = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.AutoTarget", true);
-        combatOnly = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.CombatOnly", true);
-        smartPositioning = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.SmartPositioning", true);
-        minEnemiesForSmart = sConfigMgr->GetOption<uint32>("EnhancedGroundTargeting.MinEnemiesForSmart", 2);
+        // Load configuration options and publish them to the hooks
+        EnhancedGroundTargetingConfig const& config = LoadModuleConfig();
+        StartPlacementTrace(config);
 
-        if (enabled)
+        if (config.enabled)
         {
             // Use proper logging for your core version
             LOG_INFO("server.loading", "Enhanced Ground Targeting Module: Enabled");
-            if (autoTarget)
+            if (config.autoTarget)
                 LOG_INFO("server.loading", "Enhanced Ground Targeting Module: Auto-targeting enabled");
-            if (combatOnly)
+            if (config.combatOnly)
                 LOG_INFO("server.loading", "Enhanced Ground Targeting Module: Combat-only targeting enabled");
-            if (smartPositioning)
-                LOG_INFO("server.loading", "Enhanced Ground Targeting Module: Smart positioning enabled (min enemies: {})", minEnemiesForSmart);
+            if (config.smartPositioning)
+                LOG_INFO("server.loading", "Enhanced Ground Targeting Module: Smart positioning enabled (min enemies: {})", config.minEnemiesForSmart);
             
             LOG_INFO("server.loading", "Enhanced Ground Targeting: IMPORTANT: You need to apply the SQL to your database!");
         }
     }
 
+    void OnStartup() override
+    {
+        // spell_script_names is loaded by now
+        LoadRegisteredSpells();
+    }
+
+    void OnUpdate(uint32 diff) override
+    {
+        _toggleFlushTimer += diff;
+        if (_toggleFlushTimer >= TOGGLE_FLUSH_INTERVAL)
+        {
+            _toggleFlushTimer = 0;
+            FlushPendingToggleWrites();
+        }
+
+        EnhancedGroundTargetingConfig const& config = GetModuleConfig();
+        if (!config.statsDumpInterval)
+            return;
+
+        _statsDumpTimer += diff;
+        if (_statsDumpTimer < config.statsDumpInterval * IN_MILLISECONDS)
+            return;
+
+        _statsDumpTimer = 0;
+        DumpPlacementStats(config.statsDumpFile);
+    }
+
+    void OnShutdown() override
+    {
+        FlushPendingToggleWrites();
+        placementTrace.Stop();
+    }
+
 private:
-    bool enabled;
-    bool autoTarget;
-    bool combatOnly;
-    bool smartPositioning;
-    uint32 minEnemiesForSmart;
+    uint32 _toggleFlushTimer = 0;
+    uint32 _statsDumpTimer = 0;
 };
 
 // All Spell Script for early interception
@@ -504,173 +1981,63 @@ public:
 
     bool CanPrepare(Spell* spell, SpellCastTargets const* targets, AuraEffect const* /*triggeredByAura*/) override
     {
-        if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Enable", true))
-            return true;
-            
-        if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.AutoTarget", true))
-            return true;
-
-        Unit* caster = spell->GetCaster();
-        if (!caster || !caster->ToPlayer())
-            return true;
-
-        Player* player = caster->ToPlayer();
-        
-        // Check if player has toggled off the feature
-        if (!GetPlayerToggleState(player->GetGUID().GetCounter()))
+        // Cheapest test first: this hook runs for every spell any unit casts
+        if (!IsRegisteredSpell(spell->GetSpellInfo()->Id))
             return true;
-            
-        // Check if this is one of our registered spells
-        uint32 spellId = spell->GetSpellInfo()->Id;
-        bool isRegisteredSpell = false;
-        
-        // Check against registered spell IDs
-        std::vector<uint32> registeredSpells = {
-            1510, 14294, 14295, 27022, 58431, 58432, // Volley
-            10, 6141, 8427, 10185, 10186, 10187, 27085, 42939, 42940, // Blizzard
-            5740, 6219, 11677, 11678, 27212, 47819, 47820, // Rain of Fire
-            43265, 49936, 49937, 49938, // Death and Decay
-            2120, 2121, 8422, 8423, 10215, 10216, 27086, 42925, 42926 // Flamestrike
-        };
         
-        for (uint32 registeredId : registeredSpells)
-        {
-            if (spellId == registeredId)
-            {
-                isRegisteredSpell = true;
-                break;
-            }
-        }
+        PlacementStageTimer timer(PLACEMENT_STAGE_HOOK);
         
-        if (!isRegisteredSpell)
+        Player* player = GetPlacingPlayer(spell->GetCaster());
+        if (!player)
             return true;
             
-        // ALWAYS force a valid destination, regardless of current state
-        Unit* target = player->GetSelectedUnit();
-        float targetX, targetY, targetZ;
-        
-        if (target)
-        {
-            targetX = target->GetPositionX();
-            targetY = target->GetPositionY();
-            targetZ = target->GetPositionZ();
-        }
-        else
-        {
-            targetX = player->GetPositionX();
-            targetY = player->GetPositionY();
-            targetZ = player->GetPositionZ();
-        }
-        
-        // Try smart positioning if enabled
-        bool smartEnabled = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.SmartPositioning", true);
-        if (smartEnabled && target)
-        {
-            AOEPosition optimalPos = CalculateOptimalAOEPosition(player, 8.0f, spell->GetSpellInfo());
-            if (optimalPos.isValid && optimalPos.targetCount >= 2)
-            {
-                targetX = optimalPos.x;
-                targetY = optimalPos.y;
-                targetZ = optimalPos.z;
-            }
-        }
+        // ALWAYS force a valid destination, regardless of current state. This is the first
+        // hook of the cast, so it computes the placement that the later hooks reuse.
+        CastPlacement const& placement = StartCastPlacement(player, spell);
         
-        ValidateAndAdjustPosition(player, targetX, targetY, targetZ, spell->GetSpellInfo());
-        
-        spell->m_targets.SetDst(targetX, targetY, targetZ, player->GetOrientation());
+        spell->m_targets.SetDst(placement.x, placement.y, placement.z, player->GetOrientation());
         spell->m_targets.SetTargetMask(TARGET_FLAG_DEST_LOCATION);
         spell->m_targets.SetUnitTarget(nullptr);
         
+        AddPlacementCounter(PLACEMENT_COUNTER_INTERCEPTED);
         return true;
     }
 
     void OnSpellCheckCast(Spell* spell, bool /*strict*/, SpellCastResult& res) override
     {
-        if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Enable", true))
-            return;
-            
-        if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.AutoTarget", true))
-            return;
-
-        Unit* caster = spell->GetCaster();
-        if (!caster || !caster->ToPlayer())
-            return;
-
-        Player* player = caster->ToPlayer();
-        
-        // Check if player has toggled off the feature
-        if (!GetPlayerToggleState(player->GetGUID().GetCounter()))
+        // Cheapest test first: this hook runs for every spell any unit casts
+        if (!IsRegisteredSpell(spell->GetSpellInfo()->Id))
             return;
-            
-        // Check if this is one of our registered spells
-        uint32 spellId = spell->GetSpellInfo()->Id;
-        bool isRegisteredSpell = false;
-        
-        // Check against registered spell IDs
-        std::vector<uint32> registeredSpells = {
-            // Volley
-            1510, 14294, 14295, 27022, 58431, 58432,
-            // Blizzard
-            10, 6141, 8427, 10185, 10186, 10187, 27085, 42939, 42940,
-            // Rain of Fire
-            5740, 6219, 11677, 11678, 27212, 47819, 47820,
-            // Death and Decay
-            43265, 49936, 49937, 49938,
-            // Flamestrike
-            2120, 2121, 8422, 8423, 10215, 10216, 27086, 42925, 42926
-        };
         
-        for (uint32 registeredId : registeredSpells)
-        {
-            if (spellId == registeredId)
-            {
-                isRegisteredSpell = true;
-                break;
-            }
-        }
+        PlacementStageTimer timer(PLACEMENT_STAGE_HOOK);
         
-        if (!isRegisteredSpell)
+        Player* player = GetPlacingPlayer(spell->GetCaster());
+        if (!player)
             return;
             
         // Store original error before we start modifying things
         SpellCastResult originalError = res;
         
-        // Check if we're getting a targeting error
+        // Check if we're getting a targeting error. A line of sight failure is the core's
+        // verdict on the destination and stands: overriding it would cast through walls.
         if (res == SPELL_FAILED_BAD_TARGETS || res == SPELL_FAILED_NO_VALID_TARGETS || 
             res == SPELL_FAILED_REQUIRES_AREA || res == SPELL_FAILED_BAD_IMPLICIT_TARGETS ||
-            res == SPELL_FAILED_ONLY_OUTDOORS || res == SPELL_FAILED_LINE_OF_SIGHT ||
+            res == SPELL_FAILED_ONLY_OUTDOORS ||
             res == SPELL_FAILED_OUT_OF_RANGE || res == SPELL_FAILED_TOO_CLOSE)
         {
             // Force a valid destination to bypass cursor validation
-            Unit* target = player->GetSelectedUnit();
-            float targetX, targetY, targetZ;
-            
-            if (target)
-            {
-                targetX = target->GetPositionX();
-                targetY = target->GetPositionY();
-                targetZ = target->GetPositionZ();
-            }
-            else
-            {
-                targetX = player->GetPositionX();
-                targetY = player->GetPositionY();
-                targetZ = player->GetPositionZ();
-            }
+            CastPlacement const& placement = ResolveCastPlacement(player, spell);
             
-            SpellInfo const* spellInfo = spell->GetSpellInfo();
-            ValidateAndAdjustPosition(player, targetX, targetY, targetZ, spellInfo);
-            
-            spell->m_targets.SetDst(targetX, targetY, targetZ, player->GetOrientation());
+            spell->m_targets.SetDst(placement.x, placement.y, placement.z, player->GetOrientation());
             spell->m_targets.SetTargetMask(spell->m_targets.GetTargetMask() | TARGET_FLAG_DEST_LOCATION);
             
             // Handle specific error types
             if (originalError == SPELL_FAILED_ONLY_OUTDOORS)
             {
-                targetX = player->GetPositionX() + 5.0f;
-                targetY = player->GetPositionY() + 5.0f;
-                targetZ = player->GetPositionZ();
-                player->UpdateAllowedPositionZ(targetX, targetY, targetZ);
+                float targetX = player->GetPositionX() + 5.0f;
+                float targetY = player->GetPositionY() + 5.0f;
+                float targetZ = player->GetPositionZ();
+                UpdateGroundZ(player, targetX, targetY, targetZ);
                 spell->m_targets.SetDst(targetX, targetY, targetZ, player->GetOrientation());
             }
             
@@ -678,25 +2045,9 @@ public:
         }
         else if (!(spell->m_targets.GetTargetMask() & TARGET_FLAG_DEST_LOCATION))
         {
-            Unit* target = player->GetSelectedUnit();
-            float targetX, targetY, targetZ;
-            
-            if (target)
-            {
-                targetX = target->GetPositionX();
-                targetY = target->GetPositionY();
-                targetZ = target->GetPositionZ();
-            }
-            else
-            {
-                targetX = player->GetPositionX();
-                targetY = player->GetPositionY();
-                targetZ = player->GetPositionZ();
-            }
-            
-            ValidateAndAdjustPosition(player, targetX, targetY, targetZ, spell->GetSpellInfo());
+            CastPlacement const& placement = ResolveCastPlacement(player, spell);
             
-            spell->m_targets.SetDst(targetX, targetY, targetZ, player->GetOrientation());
+            spell->m_targets.SetDst(placement.x, placement.y, placement.z, player->GetOrientation());
             spell->m_targets.SetTargetMask(spell->m_targets.GetTargetMask() | TARGET_FLAG_DEST_LOCATION);
             
         }
@@ -711,9 +2062,10 @@ public:
 
     void OnLogin(Player* player)
     {
-        if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Enable", true))
+        if (!GetModuleConfig().enabled)
             return;
 
+        LoadPlayerToggleState(player);
     }
     
     void OnPlayerSpellCast(Player* player, Spell* spell, bool /*skipCheck*/) override
@@ -721,6 +2073,25 @@ public:
     }
 };
 
+// Map Script keeping the ground height caches in step with loaded terrain
+class EnhancedGroundTargeting_AllMapScript : public AllMapScript
+{
+public:
+    EnhancedGroundTargeting_AllMapScript() : AllMapScript("EnhancedGroundTargeting_AllMapScript") {}
+
+    void OnUnloadGridMap(Map* map, GridTerrainData* /*gmap*/, uint32 gx, uint32 gy) override
+    {
+        // Maps nobody placed a spell on have no cache, and should not get one now
+        if (MapPlacementContext* context = FindMapPlacementContext(map, false))
+            context->groundHeights.InvalidateGrid(gx, gy);
+    }
+
+    void OnDestroyMap(Map* map) override
+    {
+        DestroyMapPlacementContext(map);
+    }
+};
+
 // Command Script for .toggle command
 using namespace Acore::ChatCommands;
 
@@ -734,7 +2105,8 @@ public:
         static ChatCommandTable commandTable =
         {
             { "toggle", HandleToggleCommand, SEC_PLAYER, Console::No },
-            { "testcast", HandleTestCastCommand, SEC_PLAYER, Console::No }
+            { "testcast", HandleTestCastCommand, SEC_PLAYER, Console::No },
+            { "egtstats", HandleStatsCommand, SEC_GAMEMASTER, Console::Yes }
         };
         return commandTable;
     }
@@ -745,7 +2117,7 @@ public:
         if (!player)
             return false;
 
-        if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Enable", true))
+        if (!GetModuleConfig().enabled)
         {
             handler->PSendSysMessage("Enhanced Ground Targeting is disabled on this server.");
             return true;
@@ -755,24 +2127,23 @@ public:
         std::string arg = args ? args : "";
         std::transform(arg.begin(), arg.end(), arg.begin(), ::tolower);
 
-        uint64 playerGuid = player->GetGUID().GetCounter();
-        bool currentState = GetPlayerToggleState(playerGuid);
+        bool currentState = GetPlayerToggleState(player);
 
         if (arg == "on" || arg == "enable" || arg == "1")
         {
-            SetPlayerToggleState(playerGuid, true);
+            StorePlayerToggleState(player, true);
             handler->PSendSysMessage("Enhanced Ground Targeting: |cff00ff00ENABLED|r");
         }
         else if (arg == "off" || arg == "disable" || arg == "0")
         {
-            SetPlayerToggleState(playerGuid, false);
+            StorePlayerToggleState(player, false);
             handler->PSendSysMessage("Enhanced Ground Targeting: |cffff0000DISABLED|r");
         }
         else
         {
             // Toggle current state
             bool newState = !currentState;
-            SetPlayerToggleState(playerGuid, newState);
+            StorePlayerToggleState(player, newState);
             handler->PSendSysMessage("Enhanced Ground Targeting: %s", 
                 newState ? "|cff00ff00ENABLED|r" : "|cffff0000DISABLED|r");
         }
@@ -786,7 +2157,7 @@ public:
         if (!player)
             return false;
 
-        if (!sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.Enable", true))
+        if (!GetModuleConfig().enabled)
         {
             handler->PSendSysMessage("Enhanced Ground Targeting is disabled on this server.");
             return true;
@@ -807,57 +2178,54 @@ public:
         }
         
         // Force enable the feature for this player temporarily
-        bool wasEnabled = GetPlayerToggleState(player->GetGUID().GetCounter());
-        SetPlayerToggleState(player->GetGUID().GetCounter(), true);
-        
-        // Create spell cast targets with forced destination
-        Unit* target = player->GetSelectedUnit();
-        float targetX, targetY, targetZ;
+        bool wasEnabled = GetPlayerToggleState(player);
+        SetPlayerToggleState(player, true);
         
-        if (target)
-        {
-            targetX = target->GetPositionX();
-            targetY = target->GetPositionY();
-            targetZ = target->GetPositionZ();
-        }
-        else
-        {
-            targetX = player->GetPositionX();
-            targetY = player->GetPositionY();
-            targetZ = player->GetPositionZ();
-        }
-        
-        // Ensure valid ground position
-        player->UpdateAllowedPositionZ(targetX, targetY, targetZ);
-        
-        // Try smart positioning if enabled
-        bool smartEnabled = sConfigMgr->GetOption<bool>("EnhancedGroundTargeting.SmartPositioning", true);
-        if (smartEnabled)
-        {
-            AOEPosition optimalPos = CalculateOptimalAOEPosition(player, 8.0f, spellInfo);
-            if (optimalPos.isValid && optimalPos.targetCount >= 2)
-            {
-                targetX = optimalPos.x;
-                targetY = optimalPos.y;
-                targetZ = optimalPos.z;
-            }
-        }
+        // Place it through the spell's own pipeline, like a real cast
+        CastPlacement placement;
+        ComputePlacement(player, spellInfo, placement, GetPlayerData(player)->castPlacement);
         
         // Create spell cast targets
         SpellCastTargets targets;
-        targets.SetDst(targetX, targetY, targetZ, player->GetOrientation());
+        targets.SetDst(placement.x, placement.y, placement.z, player->GetOrientation());
         targets.SetTargetMask(TARGET_FLAG_DEST_LOCATION);
         
         // Cast the spell with forced validation bypass
         SpellCastResult result = player->CastSpell(targets, spellInfo, nullptr, TRIGGERED_FULL_MASK);
         
         // Restore original state
-        SetPlayerToggleState(player->GetGUID().GetCounter(), wasEnabled);
+        SetPlayerToggleState(player, wasEnabled);
         
         handler->PSendSysMessage("Test cast result: %s", result == SPELL_CAST_OK ? "SUCCESS" : "FAILED");
         
         return true;
     }
+
+    // .egtstats [reset]: placement counters and per-stage latency percentiles
+    static bool HandleStatsCommand(ChatHandler* handler, char const* args)
+    {
+        std::string arg = args ? args : "";
+        if (arg == "reset")
+        {
+            ResetPlacementStats();
+            handler->SendSysMessage("Enhanced Ground Targeting: stats reset.");
+            return true;
+        }
+
+        std::string report = FormatPlacementStats();
+        size_t start = 0;
+        while (start < report.size())
+        {
+            size_t end = report.find('\n', start);
+            if (end == std::string::npos)
+                end = report.size();
+
+            handler->SendSysMessage(report.substr(start, end - start));
+            start = end + 1;
+        }
+
+        return true;
+    }
 };
 
 // AzerothCore script registration hook
@@ -867,5 +2235,6 @@ void AddSC_EnhancedGroundTargeting()
     new spell_enhanced_ground_targeting();
     new EnhancedGroundTargeting_AllSpellScript();
     new EnhancedGroundTargeting_PlayerScript();
+    new EnhancedGroundTargeting_AllMapScript();
     new EnhancedGroundTargeting_CommandScript();
 }
\ No newline at end of file
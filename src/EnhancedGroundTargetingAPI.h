@@ -0,0 +1,41 @@
+#ifndef ENHANCED_GROUND_TARGETING_API_H
+#define ENHANCED_GROUND_TARGETING_API_H
+
+// Placement for callers other than the module's own spell hooks: creature AI, bot sessions,
+// other modules. The answers come from the same candidate rules, solvers and tick budget as
+// player casts, so a bot places its Blizzard where a player with the module toggled on would.
+
+#include "Define.h"
+#include <vector>
+
+class Unit;
+
+// One ground-targeted spell someone is about to cast
+struct GroundPlacementRequest
+{
+    Unit* caster = nullptr;
+    uint32 spellId = 0;
+};
+
+// Where to put it. Invalid for unknown spells, casters with no enemy in reach of the spell,
+// or when the caster's map has used up its tick budget; the caller picks its own target then.
+struct GroundPlacementResult
+{
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    uint32 predictedHits = 0; // candidates inside the spell radius at the chosen center
+    bool isValid = false;
+};
+
+// Resolves every request, results[i] answering requests[i]. Casters within a few dozen yards
+// of each other share one grid scan per world tick. Requests from casters standing within
+// a yard of each other with spells of the same range, radius and line of sight rule are
+// filtered together, and each distinct set of enemies among them is solved once, so a
+// stack of casters fighting the same pack costs about one scan and one solve.
+// All casters of a batch must be on one map, and it must be called from the thread
+// updating that map (unit AI, map scripts, bot updates), like any other code touching
+// those units; a caster on another map fails an assertion.
+void ComputeGroundPlacements(std::vector<GroundPlacementRequest> const& requests, std::vector<GroundPlacementResult>& results);
+
+#endif /* ENHANCED_GROUND_TARGETING_API_H */
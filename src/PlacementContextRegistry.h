@@ -0,0 +1,100 @@
+#ifndef ENHANCED_GROUND_TARGETING_PLACEMENT_CONTEXT_REGISTRY_H
+#define ENHANCED_GROUND_TARGETING_PLACEMENT_CONTEXT_REGISTRY_H
+
+// Per-map state lookup, core-independent so the benchmark can drive it from many threads.
+// Contexts are created on a key's first use and destroyed with it. The lock is only taken
+// when a thread meets a key it has not cached yet, or after some key was destroyed; every
+// other lookup is one atomic load and a scan of a few thread-local pointers.
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// The thread-local lookaside is shared by every registry of the same Key/Context pair, so
+// there must be only one such registry per process
+template<class Key, class Context>
+class PlacementContextRegistry
+{
+public:
+    // The key's context, created on first use if 'create' is set; otherwise null for a key
+    // that has none yet
+    Context* Find(Key const* key, bool create)
+    {
+        Lookaside& lookaside = GetLookaside();
+        uint32_t generation = _generation.load(std::memory_order_acquire);
+        if (lookaside.generation != generation)
+            lookaside = Lookaside{ .generation = generation };
+
+        for (uint32_t i = 0; i < Lookaside::SIZE; ++i)
+            if (lookaside.keys[i] == key)
+                return lookaside.contexts[i];
+
+        Context* context;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (create)
+            {
+                std::unique_ptr<Context>& entry = _contexts[key];
+                if (!entry)
+                    entry = std::make_unique<Context>();
+
+                context = entry.get();
+            }
+            else
+            {
+                auto it = _contexts.find(key);
+                if (it == _contexts.end())
+                    return nullptr;
+
+                context = it->second.get();
+            }
+        }
+
+        uint32_t slot = lookaside.next++ % Lookaside::SIZE;
+        lookaside.keys[slot] = key;
+        lookaside.contexts[slot] = context;
+        return context;
+    }
+
+    Context& Get(Key const* key)
+    {
+        return *Find(key, true);
+    }
+
+    // No thread may be using the key's context any more
+    void Destroy(Key const* key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _contexts.erase(key);
+
+        // Drops every thread's cached pointers, which may name this key or a new one at its address
+        _generation.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    // Last few keys this thread looked up; a map thread updates one map at a time, so this
+    // hits for every placement but the first of each map update
+    struct Lookaside
+    {
+        static constexpr uint32_t SIZE = 4;
+
+        Key const* keys[SIZE] = { };
+        Context* contexts[SIZE] = { };
+        uint32_t generation = 0;
+        uint32_t next = 0;
+    };
+
+    static Lookaside& GetLookaside()
+    {
+        static thread_local Lookaside lookaside;
+        return lookaside;
+    }
+
+    std::unordered_map<Key const*, std::unique_ptr<Context>> _contexts;
+    std::mutex _mutex;
+    std::atomic<uint32_t> _generation{ 0 };
+};
+
+#endif /* ENHANCED_GROUND_TARGETING_PLACEMENT_CONTEXT_REGISTRY_H */
@@ -0,0 +1,727 @@
+#include "PlacementEngine.h"
+#include "PlacementStats.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <utility>
+#if defined(__SSE2__) || defined(__AVX2__) || defined(_M_X64) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define PLACEMENT_PI 3.14159265358979323846
+
+// Scalar reference version of CountPointsInRange; the SIMD variants below must agree with it exactly.
+static uint32_t CountPointsInRangeScalar(float const* xs, float const* ys, uint32_t count, float x, float y, float rangeSq)
+{
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        float dx = xs[i] - x;
+        float dy = ys[i] - y;
+        hits += (dx * dx + dy * dy <= rangeSq) ? 1 : 0;
+    }
+
+    return hits;
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EGT_SIMD_SSE2
+static uint32_t CountPointsInRangeSSE2(float const* xs, float const* ys, uint32_t count, float x, float y, float rangeSq)
+{
+    __m128 const qx = _mm_set1_ps(x);
+    __m128 const qy = _mm_set1_ps(y);
+    __m128 const r2 = _mm_set1_ps(rangeSq);
+
+    uint32_t hits = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), qx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), qy);
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        hits += std::popcount(static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(d2, r2))));
+    }
+
+    return hits + CountPointsInRangeScalar(xs + i, ys + i, count - i, x, y, rangeSq);
+}
+#endif
+
+// AVX2 is picked at run time on GCC/Clang, so stock x86-64 builds still use it where available
+#if defined(__AVX2__) || (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+#define EGT_SIMD_AVX2
+#if !defined(__AVX2__)
+__attribute__((target("avx2")))
+#endif
+static uint32_t CountPointsInRangeAVX2(float const* xs, float const* ys, uint32_t count, float x, float y, float rangeSq)
+{
+    __m256 const qx = _mm256_set1_ps(x);
+    __m256 const qy = _mm256_set1_ps(y);
+    __m256 const r2 = _mm256_set1_ps(rangeSq);
+
+    uint32_t hits = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        // Separate mul and add (no FMA) so rim decisions match the scalar version bit for bit
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs + i), qx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys + i), qy);
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        hits += std::popcount(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(d2, r2, _CMP_LE_OQ))));
+    }
+
+    return hits + CountPointsInRangeScalar(xs + i, ys + i, count - i, x, y, rangeSq);
+}
+#endif
+
+typedef uint32_t (*CountPointsInRangeFn)(float const*, float const*, uint32_t, float, float, float);
+
+static CountPointsInRangeFn SelectCountPointsInRange()
+{
+#if defined(__AVX2__)
+    return &CountPointsInRangeAVX2;
+#else
+#if defined(EGT_SIMD_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return &CountPointsInRangeAVX2;
+#endif
+#if defined(EGT_SIMD_SSE2)
+    return &CountPointsInRangeSSE2;
+#else
+    return &CountPointsInRangeScalar;
+#endif
+#endif
+}
+
+uint32_t CountPointsInRange(float const* xs, float const* ys, uint32_t count, float x, float y, float rangeSq)
+{
+    static CountPointsInRangeFn const kernel = SelectCountPointsInRange();
+    return kernel(xs, ys, count, x, y, rangeSq);
+}
+
+// Working memory of the solvers. Each thread keeps its own and buffers only ever grow, so
+// once a thread has placed on its largest fight a placement no longer touches the heap.
+// No solver calls another while holding it, so one set per thread is enough.
+struct PlacementScratch
+{
+    ClusterGrid grid;
+    std::vector<PlacementPoint> local;
+    std::vector<std::pair<float, int32_t>> events;
+    std::vector<uint32_t> cluster;
+    std::vector<uint32_t> densityMap;
+};
+
+static PlacementScratch& GetPlacementScratch()
+{
+    static thread_local PlacementScratch scratch;
+    return scratch;
+}
+
+void ClusterGrid::Build(std::vector<PlacementPoint> const& points, float cellSize)
+{
+    // Padded slightly so float rounding can never push a neighbour two cells away
+    _invCellSize = 1.0f / (std::max(cellSize, 0.1f) * 1.001f);
+
+    uint32_t itemCount = points.size();
+    uint32_t tableSize = 16;
+    while (tableSize < itemCount * 2)
+        tableSize <<= 1;
+
+    _mask = tableSize - 1;
+    _cells.assign(tableSize, Bucket());
+    _itemCell.resize(itemCount);
+    _itemSlot.resize(itemCount);
+    _order.resize(itemCount);
+    _xs.resize(itemCount);
+    _ys.resize(itemCount);
+
+    // Store coordinates relative to the first point; world coordinates run into the
+    // thousands, where a float only resolves about a millimetre.
+    _originX = itemCount ? points[0].x : 0.0f;
+    _originY = itemCount ? points[0].y : 0.0f;
+
+    _occupied.clear();
+    for (uint32_t i = 0; i < itemCount; ++i)
+    {
+        int32_t cx = CellCoord(points[i].x - _originX);
+        int32_t cy = CellCoord(points[i].y - _originY);
+        uint32_t slot = Probe(cx, cy);
+
+        Bucket& cell = _cells[slot];
+        if (!cell.count)
+        {
+            cell.cx = cx;
+            cell.cy = cy;
+            _occupied.push_back(slot);
+        }
+
+        ++cell.count;
+        _itemCell[i] = slot;
+    }
+
+    std::sort(_occupied.begin(), _occupied.end(), [this](uint32_t a, uint32_t b)
+    {
+        return _cells[a].cx < _cells[b].cx || (_cells[a].cx == _cells[b].cx && _cells[a].cy < _cells[b].cy);
+    });
+
+    // Turn the per-cell counts into start offsets, then scatter the positions
+    uint32_t offset = 0;
+    for (uint32_t slot : _occupied)
+    {
+        _cells[slot].start = offset;
+        _cells[slot].fill = offset;
+        offset += _cells[slot].count;
+    }
+
+    for (uint32_t i = 0; i < itemCount; ++i)
+    {
+        uint32_t position = _cells[_itemCell[i]].fill++;
+        _order[position] = i;
+        _itemSlot[i] = position;
+        _xs[position] = points[i].x - _originX;
+        _ys[position] = points[i].y - _originY;
+    }
+}
+
+int32_t ClusterGrid::CellCoord(float value) const
+{
+    return static_cast<int32_t>(std::floor(value * _invCellSize));
+}
+
+bool FindMaxDensity(std::vector<PlacementPoint> const& points, float aoeRadius, std::vector<uint32_t>& members)
+{
+    members.clear();
+    if (points.empty())
+        return false;
+
+    // Use 2x radius for better clustering; the grid cells are as wide as that range
+    float clusterRange = aoeRadius * 2.0f;
+    float clusterRangeSq = clusterRange * clusterRange;
+    ClusterGrid& grid = GetPlacementScratch().grid;
+    grid.Build(points, clusterRange);
+
+    uint32_t maxCount = 0;
+    uint32_t bestCenter = 0;
+
+    // For each potential target, count how many other targets are within 2x AOE radius.
+    // Only the three grid columns around it can qualify; they are scanned with the SIMD
+    // distance kernel, and the first point reaching the highest count wins, exactly like
+    // the pairwise scan did.
+    for (uint32_t i = 0; i < points.size(); ++i)
+    {
+        uint32_t count = grid.CountNeighbours(i, clusterRangeSq);
+        if (count > maxCount)
+        {
+            maxCount = count;
+            bestCenter = i;
+        }
+    }
+
+    // Rebuild the winning group in candidate order
+    members.reserve(maxCount);
+    grid.ForEachNeighbour(bestCenter, clusterRangeSq, [&](uint32_t j)
+    {
+        members.push_back(j);
+    });
+    std::sort(members.begin(), members.end());
+
+    return true;
+}
+
+// A millimetre of tolerance keeps points that sit exactly on the rim, which is where the
+// max-coverage sweep places most of its candidates.
+uint32_t CountCoveredPoints(std::vector<PlacementPoint> const& points, float x, float y, float radius)
+{
+    float rangeSq = (radius + 0.001f) * (radius + 0.001f);
+    uint32_t count = 0;
+
+    for (PlacementPoint const& point : points)
+    {
+        float dx = point.x - x;
+        float dy = point.y - y;
+        if (dx * dx + dy * dy <= rangeSq)
+            ++count;
+    }
+
+    return count;
+}
+
+// If some disc covers k points, it can be slid until one of them sits on its rim, so it is
+// enough to sweep, for every point, the circle of candidate centers around it and find the
+// arc covered by most neighbour intervals. Neighbours come from a 2r grid, which makes the
+// whole search O(n * k log k) for k neighbours per point and O(n^2 log n) at worst.
+//
+// The reach disc enters each sweep as one more interval, weighted above every possible
+// neighbour count, so only arcs inside it can win. A best region inside the reach disc is
+// either bounded by some point's circle, which the sweep visits, or covers the whole disc,
+// in which case any point of the disc does; the starting candidate is such a point.
+bool FindMaxCoverageCenter(std::vector<PlacementPoint> const& points, float radius, PlacementPoint const& reachCenter, float reachRadius,
+    float& outX, float& outY, uint32_t& outHits)
+{
+    if (points.empty() || radius <= 0.0f)
+        return false;
+
+    float const twoPi = 2.0f * float(PLACEMENT_PI);
+    float reach = radius * 2.0f;
+    bool constrained = reachRadius > 0.0f;
+
+    // Work relative to the first point; world coordinates run into the thousands, where
+    // a float only resolves about a millimetre and rim decisions become unreliable.
+    PlacementScratch& scratch = GetPlacementScratch();
+    PlacementPoint origin = points[0];
+    std::vector<PlacementPoint>& local = scratch.local;
+    local.clear();
+    for (PlacementPoint const& point : points)
+        local.push_back({ point.x - origin.x, point.y - origin.y });
+
+    float casterX = reachCenter.x - origin.x;
+    float casterY = reachCenter.y - origin.y;
+
+    // Start from the point nearest to the caster, pulled into reach if needed
+    float bestX = 0.0f;
+    float bestY = 0.0f;
+    if (constrained)
+    {
+        float nearestSq = -1.0f;
+        for (PlacementPoint const& point : local)
+        {
+            float dx = point.x - casterX;
+            float dy = point.y - casterY;
+            float distSq = dx * dx + dy * dy;
+            if (nearestSq < 0.0f || distSq < nearestSq)
+            {
+                nearestSq = distSq;
+                bestX = point.x;
+                bestY = point.y;
+            }
+        }
+
+        ClampToReach(casterX, casterY, reachRadius, bestX, bestY);
+    }
+
+    uint32_t bestDepth = CountCoveredPoints(local, bestX, bestY, radius);
+
+    ClusterGrid& grid = scratch.grid;
+    grid.Build(local, reach);
+
+    // (angle, +1 entering / -1 leaving); entries sort first so touching arcs overlap
+    std::vector<std::pair<float, int32_t>>& events = scratch.events;
+
+    // Weight of the reach interval, more than any neighbour count can add up to
+    int32_t const reachWeight = int32_t(local.size()) + 1;
+
+    // Adds the interval of angles [start, start + width), wrapping past zero if needed
+    auto addInterval = [&](float start, float width, int32_t weight, uint32_t& baseDepth)
+    {
+        if (start < 0.0f)
+            start += twoPi;
+
+        float end = start + width;
+        if (end >= twoPi)
+        {
+            // Interval wraps past angle zero: it is active at the start of the sweep
+            baseDepth += weight;
+            events.emplace_back(end - twoPi, -weight);
+            events.emplace_back(start, weight);
+        }
+        else
+        {
+            events.emplace_back(start, weight);
+            events.emplace_back(end, -weight);
+        }
+    };
+
+    for (uint32_t i = 0; i < local.size(); ++i)
+    {
+        PlacementPoint const& pivot = local[i];
+        uint32_t baseDepth = 1; // the pivot itself lies on the rim
+        events.clear();
+
+        if (constrained)
+        {
+            // Arc of this pivot's circle lying inside the reach disc
+            float dx = casterX - pivot.x;
+            float dy = casterY - pivot.y;
+            float dist = std::sqrt(dx * dx + dy * dy);
+
+            if (dist + radius <= reachRadius)
+                baseDepth += reachWeight; // whole circle in reach
+            else if (dist > reachRadius + radius || dist + reachRadius < radius)
+                continue; // whole circle out of reach
+            else
+            {
+                float cosHalf = (dist * dist + radius * radius - reachRadius * reachRadius) / (2.0f * dist * radius);
+                float half = std::acos(std::clamp(cosHalf, -1.0f, 1.0f));
+                addInterval(std::atan2(dy, dx) - half, 2.0f * half, reachWeight, baseDepth);
+            }
+        }
+
+        grid.ForEachNeighbourCandidate(i, [&](uint32_t j)
+        {
+            if (j == i)
+                return;
+
+            float dx = local[j].x - pivot.x;
+            float dy = local[j].y - pivot.y;
+            float dist = std::sqrt(dx * dx + dy * dy);
+            if (dist > reach)
+                return;
+
+            if (dist < 0.001f)
+            {
+                ++baseDepth; // stacked on the pivot, covered from every angle
+                return;
+            }
+
+            float half = std::acos(std::min(1.0f, dist / reach));
+            addInterval(std::atan2(dy, dx) - half, 2.0f * half, 1, baseDepth);
+        });
+
+        std::sort(events.begin(), events.end(), [](std::pair<float, int32_t> const& a, std::pair<float, int32_t> const& b)
+        {
+            return a.first < b.first || (a.first == b.first && a.second > b.second);
+        });
+
+        // Walk the arcs between consecutive events and keep the deepest one
+        uint32_t depth = baseDepth;
+        float arcStart = 0.0f;
+        float bestArcStart = 0.0f;
+        float bestArcEnd = 0.0f;
+        uint32_t pivotBest = 0;
+
+        for (size_t e = 0; e <= events.size(); ++e)
+        {
+            float arcEnd = e < events.size() ? events[e].first : twoPi;
+            if (depth > pivotBest)
+            {
+                pivotBest = depth;
+                bestArcStart = arcStart;
+                bestArcEnd = arcEnd;
+            }
+
+            if (e < events.size())
+            {
+                depth += events[e].second;
+                arcStart = arcEnd;
+            }
+        }
+
+        if (constrained)
+        {
+            if (pivotBest < uint32_t(reachWeight))
+                continue; // float noise left no arc inside the reach
+
+            pivotBest -= reachWeight;
+        }
+
+        if (pivotBest > bestDepth)
+        {
+            // Middle of the arc keeps the margin to both neighbours that bound it
+            float angle = (bestArcStart + bestArcEnd) * 0.5f;
+            float x = pivot.x + radius * std::cos(angle);
+            float y = pivot.y + radius * std::sin(angle);
+            if (constrained)
+                ClampToReach(casterX, casterY, reachRadius, x, y);
+
+            bestDepth = pivotBest;
+            bestX = x;
+            bestY = y;
+        }
+    }
+
+    // Pull the disc onto the centroid of what it covers when that loses nobody; this
+    // leaves more room for enemies that shuffle around before the spell lands.
+    float sumX = 0.0f, sumY = 0.0f;
+    uint32_t covered = 0;
+    float rangeSq = (radius + 0.001f) * (radius + 0.001f);
+    for (PlacementPoint const& point : local)
+    {
+        float dx = point.x - bestX;
+        float dy = point.y - bestY;
+        if (dx * dx + dy * dy <= rangeSq)
+        {
+            sumX += point.x;
+            sumY += point.y;
+            ++covered;
+        }
+    }
+
+    if (covered)
+    {
+        float centroidX = sumX / covered;
+        float centroidY = sumY / covered;
+        bool inReach = !constrained || std::hypot(centroidX - casterX, centroidY - casterY) <= reachRadius;
+        if (inReach && CountCoveredPoints(local, centroidX, centroidY, radius) >= covered)
+        {
+            bestX = centroidX;
+            bestY = centroidY;
+        }
+    }
+
+    outX = origin.x + bestX;
+    outY = origin.y + bestY;
+    outHits = CountCoveredPoints(local, bestX, bestY, radius);
+    return true;
+}
+
+bool FindMaxCoverageCenter(std::vector<PlacementPoint> const& points, float radius, float& outX, float& outY, uint32_t& outHits)
+{
+    return FindMaxCoverageCenter(points, radius, { 0.0f, 0.0f }, 0.0f, outX, outY, outHits);
+}
+
+// The window summed around each cell is the square with the disc's area, which ranks cells
+// much like the disc does; the exact count is only taken for the winner and its refinements.
+bool FindDensityMapCenter(std::vector<PlacementPoint> const& points, float radius, PlacementPoint const& reachCenter, float reachRadius,
+    float& outX, float& outY, uint32_t& outHits)
+{
+    if (points.empty() || radius <= 0.0f)
+        return false;
+
+    bool constrained = reachRadius > 0.0f;
+
+    // Work relative to the first point, like the coverage sweep
+    PlacementScratch& scratch = GetPlacementScratch();
+    PlacementPoint origin = points[0];
+    std::vector<PlacementPoint>& local = scratch.local;
+    local.clear();
+
+    float minX = 0.0f, maxX = 0.0f, minY = 0.0f, maxY = 0.0f;
+    for (PlacementPoint const& point : points)
+    {
+        PlacementPoint relative = { point.x - origin.x, point.y - origin.y };
+        minX = std::min(minX, relative.x);
+        maxX = std::max(maxX, relative.x);
+        minY = std::min(minY, relative.y);
+        maxY = std::max(maxY, relative.y);
+        local.push_back(relative);
+    }
+
+    float casterX = reachCenter.x - origin.x;
+    float casterY = reachCenter.y - origin.y;
+
+    // Cells no finer than an eighth of the radius, and never more than the fixed map holds
+    float cellSize = std::max({ (maxX - minX) / PLACEMENT_DENSITY_MAP_CELLS, (maxY - minY) / PLACEMENT_DENSITY_MAP_CELLS, radius / 8.0f });
+    float invCellSize = 1.0f / cellSize;
+    uint32_t columns = std::min(PLACEMENT_DENSITY_MAP_CELLS, uint32_t((maxX - minX) * invCellSize) + 1);
+    uint32_t rows = std::min(PLACEMENT_DENSITY_MAP_CELLS, uint32_t((maxY - minY) * invCellSize) + 1);
+    uint32_t stride = columns + 1;
+
+    // Summed-area table with a zero border row and column: sat[(y + 1) * stride + x + 1] is
+    // the number of candidates in cells [0, x] x [0, y]
+    std::vector<uint32_t>& sat = scratch.densityMap;
+    sat.assign(size_t(stride) * (rows + 1), 0);
+
+    for (PlacementPoint const& point : local)
+    {
+        uint32_t cx = std::min(columns - 1, uint32_t((point.x - minX) * invCellSize));
+        uint32_t cy = std::min(rows - 1, uint32_t((point.y - minY) * invCellSize));
+        ++sat[(cy + 1) * stride + cx + 1];
+    }
+
+    for (uint32_t y = 1; y <= rows; ++y)
+        for (uint32_t x = 1; x <= columns; ++x)
+            sat[y * stride + x] += sat[y * stride + x - 1] + sat[(y - 1) * stride + x] - sat[(y - 1) * stride + x - 1];
+
+    // Half side of the square with the disc's area, in cells
+    int32_t half = int32_t(radius * 0.886227f * invCellSize);
+    float reachSq = reachRadius * reachRadius;
+
+    uint32_t bestCount = 0;
+    float bestX = 0.0f;
+    float bestY = 0.0f;
+    bool found = false;
+
+    for (uint32_t y = 0; y < rows; ++y)
+    {
+        float centerY = minY + (y + 0.5f) * cellSize;
+        uint32_t y0 = uint32_t(std::max(0, int32_t(y) - half));
+        uint32_t y1 = std::min(rows, y + half + 1);
+
+        for (uint32_t x = 0; x < columns; ++x)
+        {
+            float centerX = minX + (x + 0.5f) * cellSize;
+            if (constrained)
+            {
+                float dx = centerX - casterX;
+                float dy = centerY - casterY;
+                if (dx * dx + dy * dy > reachSq)
+                    continue;
+            }
+
+            uint32_t x0 = uint32_t(std::max(0, int32_t(x) - half));
+            uint32_t x1 = std::min(columns, x + half + 1);
+            uint32_t count = sat[y1 * stride + x1] - sat[y0 * stride + x1] - sat[y1 * stride + x0] + sat[y0 * stride + x0];
+
+            if (!found || count > bestCount)
+            {
+                found = true;
+                bestCount = count;
+                bestX = centerX;
+                bestY = centerY;
+            }
+        }
+    }
+
+    // No cell center in reach: start from the candidate nearest to the caster, pulled in
+    if (!found)
+    {
+        float nearestSq = -1.0f;
+        for (PlacementPoint const& point : local)
+        {
+            float dx = point.x - casterX;
+            float dy = point.y - casterY;
+            float distSq = dx * dx + dy * dy;
+            if (nearestSq < 0.0f || distSq < nearestSq)
+            {
+                nearestSq = distSq;
+                bestX = point.x;
+                bestY = point.y;
+            }
+        }
+
+        ClampToReach(casterX, casterY, reachRadius, bestX, bestY);
+    }
+
+    // Sub-cell refinement: move onto the centroid of the covered candidates while that
+    // covers at least as many, which settles within a few steps
+    uint32_t bestHits = CountCoveredPoints(local, bestX, bestY, radius);
+    float rangeSq = (radius + 0.001f) * (radius + 0.001f);
+
+    for (uint32_t step = 0; step < 4; ++step)
+    {
+        float sumX = 0.0f, sumY = 0.0f;
+        uint32_t covered = 0;
+        for (PlacementPoint const& point : local)
+        {
+            float dx = point.x - bestX;
+            float dy = point.y - bestY;
+            if (dx * dx + dy * dy <= rangeSq)
+            {
+                sumX += point.x;
+                sumY += point.y;
+                ++covered;
+            }
+        }
+
+        if (!covered)
+            break;
+
+        float x = sumX / covered;
+        float y = sumY / covered;
+        if (constrained)
+            ClampToReach(casterX, casterY, reachRadius, x, y);
+
+        uint32_t hits = CountCoveredPoints(local, x, y, radius);
+        if (hits < bestHits || (x == bestX && y == bestY))
+            break;
+
+        bestHits = hits;
+        bestX = x;
+        bestY = y;
+    }
+
+    outX = origin.x + bestX;
+    outY = origin.y + bestY;
+    outHits = bestHits;
+    return true;
+}
+
+void ClampToReach(float centerX, float centerY, float reachRadius, float& x, float& y)
+{
+    float dx = x - centerX;
+    float dy = y - centerY;
+    float dist = std::sqrt(dx * dx + dy * dy);
+    if (dist <= reachRadius)
+        return;
+
+    float scale = reachRadius / dist;
+    x = centerX + dx * scale;
+    y = centerY + dy * scale;
+}
+
+// How far from the caster a center may go for a spell of 'maxRange'. Ranges too short to
+// spare the margin keep it whole: a negative reach would mirror points through the caster,
+// and zero means unconstrained to the solvers.
+static float GetPlacementReach(float maxRange)
+{
+    return maxRange > PLACEMENT_RANGE_MARGIN ? maxRange - PLACEMENT_RANGE_MARGIN : maxRange;
+}
+
+void ValidateAndAdjustPosition(PlacementWorldQuery const& world, float& x, float& y, float& z, float maxRange)
+{
+    PlacementStageTimer timer(PLACEMENT_STAGE_VALIDATE);
+    PlacementPosition caster = world.GetCasterPosition();
+
+    // Range is checked in 2D, so pull the point into reach before asking for the ground
+    // there; the solvers already place their centers in reach, this only catches the
+    // target and self fallbacks.
+    if (maxRange > 0)
+        ClampToReach(caster.x, caster.y, GetPlacementReach(maxRange), x, y);
+
+    // AzerothCore 6-yard Z-difference rule (SpellEffects.cpp:2502-2503)
+    if (std::fabs(caster.z - z) > 6.0f)
+    {
+        z = caster.z; // Adjust Z like AzerothCore does
+    }
+
+    // Update ground position using AzerothCore method
+    world.UpdateGroundZ(x, y, z);
+}
+
+AOEPosition CalculateOptimalAOEPosition(PlacementWorldQuery const& world, std::vector<PlacementPoint> const& points,
+    float aoeRadius, float maxRange, PlacementSolver solver)
+{
+    if (points.empty())
+        return AOEPosition();
+
+    float centerX, centerY;
+    uint32_t hits;
+
+    PlacementPosition caster = world.GetCasterPosition();
+    float reachRadius = maxRange > 0 ? GetPlacementReach(maxRange) : 0.0f;
+
+    if (solver == PLACEMENT_SOLVER_MAX_COVERAGE)
+    {
+        PlacementStageTimer timer(PLACEMENT_STAGE_SOLVE);
+        if (!FindMaxCoverageCenter(points, aoeRadius, { caster.x, caster.y }, reachRadius, centerX, centerY, hits))
+            return AOEPosition();
+    }
+    else if (solver == PLACEMENT_SOLVER_DENSITY_MAP)
+    {
+        PlacementStageTimer timer(PLACEMENT_STAGE_SOLVE);
+        if (!FindDensityMapCenter(points, aoeRadius, { caster.x, caster.y }, reachRadius, centerX, centerY, hits))
+            return AOEPosition();
+    }
+    else
+    {
+        PlacementStageTimer timer(PLACEMENT_STAGE_SOLVE);
+        std::vector<uint32_t>& cluster = GetPlacementScratch().cluster;
+        if (!FindMaxDensity(points, aoeRadius, cluster))
+            return AOEPosition();
+
+        // Calculate bounding box of the cluster (playerbot method)
+        float x1 = points[cluster[0]].x, x2 = x1;
+        float y1 = points[cluster[0]].y, y2 = y1;
+        for (uint32_t index : cluster)
+        {
+            x1 = std::min(x1, points[index].x);
+            x2 = std::max(x2, points[index].x);
+            y1 = std::min(y1, points[index].y);
+            y2 = std::max(y2, points[index].y);
+        }
+
+        // Calculate center point of bounding box
+        centerX = (x1 + x2) / 2.0f;
+        centerY = (y1 + y2) / 2.0f;
+        hits = cluster.size();
+    }
+
+    float centerZ = caster.z;
+    ValidateAndAdjustPosition(world, centerX, centerY, centerZ, maxRange);
+
+    // Every solver reports what the validated center really covers. For the cluster solver
+    // this replaces the size of the densest 2x radius group, which callers comparing hits
+    // against a threshold or against later coverage would otherwise misread.
+    hits = CountCoveredPoints(points, centerX, centerY, aoeRadius);
+
+    return AOEPosition(centerX, centerY, centerZ, hits);
+}
@@ -0,0 +1,215 @@
+#ifndef ENHANCED_GROUND_TARGETING_PLACEMENT_ENGINE_H
+#define ENHANCED_GROUND_TARGETING_PLACEMENT_ENGINE_H
+
+// Core-independent AoE placement math. Everything here works on plain positions and talks
+// to the world only through PlacementWorldQuery, so it builds and runs without a
+// worldserver (see the standalone branch of CMakeLists.txt and bench/).
+
+#include <cstdint>
+#include <vector>
+
+// Plain 2D position used by the placement solvers
+struct PlacementPoint
+{
+    float x, y;
+};
+
+// Plain 3D position exchanged with the world
+struct PlacementPosition
+{
+    float x, y, z;
+};
+
+// Structure to hold AOE position data
+struct AOEPosition
+{
+    float x, y, z;
+    uint32_t targetCount;
+    bool isValid;
+
+    AOEPosition() : x(0.0f), y(0.0f), z(0.0f), targetCount(0), isValid(false) {}
+    AOEPosition(float _x, float _y, float _z, uint32_t _count) : x(_x), y(_y), z(_z), targetCount(_count), isValid(true) {}
+};
+
+// How CalculateOptimalAOEPosition turns the nearby enemies into a spell center
+enum PlacementSolver : uint32_t
+{
+    PLACEMENT_SOLVER_CLUSTER_CENTER = 0, // bounding-box center of the densest 2x radius cluster (playerbot method)
+    PLACEMENT_SOLVER_MAX_COVERAGE   = 1, // exact point covering the most enemies within the real radius
+    PLACEMENT_SOLVER_DENSITY_MAP    = 2, // best cell of a summed-area density map, refined; for very large fights
+    MAX_PLACEMENT_SOLVERS
+};
+
+// The few world lookups placement needs, answered for one caster
+class PlacementWorldQuery
+{
+public:
+    virtual ~PlacementWorldQuery() = default;
+
+    // Position of the caster the placement is computed for
+    virtual PlacementPosition GetCasterPosition() const = 0;
+
+    // Moves z onto the ground at (x, y), like WorldObject::UpdateAllowedPositionZ
+    virtual void UpdateGroundZ(float x, float y, float& z) const = 0;
+};
+
+// Number of points among xs/ys[0, count) whose squared distance to (x, y) is at most rangeSq.
+// Runs on AVX2 or SSE2 when the CPU has it, with a scalar fallback.
+uint32_t CountPointsInRange(float const* xs, float const* ys, uint32_t count, float x, float y, float rangeSq);
+
+// Uniform grid over a candidate set. Cells are as wide as the neighbour distance, so every
+// point within that distance of a candidate lies in the candidate's cell or one of the eight
+// cells around it. Positions are copied once into structure-of-arrays storage ordered by
+// (cell x, cell y), which puts the three cells of a grid column back to back: a neighbour
+// query is three contiguous runs that the distance kernel can stream through.
+class ClusterGrid
+{
+public:
+    void Build(std::vector<PlacementPoint> const& points, float cellSize);
+
+    // Number of points within sqrt(rangeSq) of point 'index', itself included
+    uint32_t CountNeighbours(uint32_t index, float rangeSq) const
+    {
+        float x = _xs[_itemSlot[index]];
+        float y = _ys[_itemSlot[index]];
+
+        uint32_t count = 0;
+        ForEachNeighbourRun(index, [&](uint32_t first, uint32_t length)
+        {
+            count += CountPointsInRange(_xs.data() + first, _ys.data() + first, length, x, y, rangeSq);
+        });
+
+        return count;
+    }
+
+    // Calls fn(index) for every point sharing a cell with, or adjacent to, point 'index'
+    template<class Fn>
+    void ForEachNeighbourCandidate(uint32_t index, Fn&& fn) const
+    {
+        ForEachNeighbourRun(index, [&](uint32_t first, uint32_t length)
+        {
+            for (uint32_t i = first; i < first + length; ++i)
+                fn(_order[i]);
+        });
+    }
+
+    // Same as above, restricted to points within sqrt(rangeSq) of point 'index'
+    template<class Fn>
+    void ForEachNeighbour(uint32_t index, float rangeSq, Fn&& fn) const
+    {
+        float x = _xs[_itemSlot[index]];
+        float y = _ys[_itemSlot[index]];
+
+        ForEachNeighbourRun(index, [&](uint32_t first, uint32_t length)
+        {
+            for (uint32_t i = first; i < first + length; ++i)
+            {
+                float dx = _xs[i] - x;
+                float dy = _ys[i] - y;
+                if (dx * dx + dy * dy <= rangeSq)
+                    fn(_order[i]);
+            }
+        });
+    }
+
+private:
+    struct Bucket
+    {
+        int32_t cx = 0;
+        int32_t cy = 0;
+        uint32_t start = 0;
+        uint32_t fill = 0;
+        uint32_t count = 0;
+    };
+
+    int32_t CellCoord(float value) const;
+
+    // Returns the slot holding cell (cx, cy), or the empty slot where it would be inserted
+    uint32_t Probe(int32_t cx, int32_t cy) const
+    {
+        uint32_t slot = ((static_cast<uint32_t>(cx) * 73856093u) ^ (static_cast<uint32_t>(cy) * 19349663u)) & _mask;
+        while (_cells[slot].count && (_cells[slot].cx != cx || _cells[slot].cy != cy))
+            slot = (slot + 1) & _mask;
+
+        return slot;
+    }
+
+    // Calls fn(first, length) with the stored run of each of the three columns around 'index'
+    template<class Fn>
+    void ForEachNeighbourRun(uint32_t index, Fn&& fn) const
+    {
+        Bucket const& home = _cells[_itemCell[index]];
+
+        for (int32_t dx = -1; dx <= 1; ++dx)
+        {
+            uint32_t first = 0;
+            uint32_t last = 0;
+            for (int32_t dy = -1; dy <= 1; ++dy)
+            {
+                Bucket const& cell = _cells[Probe(home.cx + dx, home.cy + dy)];
+                if (!cell.count)
+                    continue;
+
+                if (first == last)
+                    first = cell.start;
+                last = cell.start + cell.count;
+            }
+
+            if (last > first)
+                fn(first, last - first);
+        }
+    }
+
+    float _invCellSize = 1.0f;
+    float _originX = 0.0f;
+    float _originY = 0.0f;
+    uint32_t _mask = 0;
+    std::vector<Bucket> _cells;
+    std::vector<uint32_t> _occupied;
+    std::vector<uint32_t> _itemCell;
+    std::vector<uint32_t> _itemSlot;
+    std::vector<uint32_t> _order;
+    std::vector<float> _xs;
+    std::vector<float> _ys;
+};
+
+// Find maximum density cluster of enemies (based on playerbot algorithm). Fills 'members'
+// with the indices of the densest 2x radius group, in candidate order.
+bool FindMaxDensity(std::vector<PlacementPoint> const& points, float aoeRadius, std::vector<uint32_t>& members);
+
+// Counts the points within 'radius' of (x, y), with a millimetre of tolerance on the rim
+uint32_t CountCoveredPoints(std::vector<PlacementPoint> const& points, float x, float y, float radius);
+
+// Centers are kept this far inside the spell's max range so rounding never puts them out
+constexpr float PLACEMENT_RANGE_MARGIN = 0.5f;
+
+// Exact maximum-coverage placement: finds a center covering the most points within 'radius'
+bool FindMaxCoverageCenter(std::vector<PlacementPoint> const& points, float radius, float& outX, float& outY, uint32_t& outHits);
+
+// Same, with the center restricted to within 'reachRadius' of 'reachCenter' (no limit if 0)
+bool FindMaxCoverageCenter(std::vector<PlacementPoint> const& points, float radius, PlacementPoint const& reachCenter, float reachRadius,
+    float& outX, float& outY, uint32_t& outHits);
+
+// Cells per side of the density map; its memory stays fixed whatever the candidate count
+constexpr uint32_t PLACEMENT_DENSITY_MAP_CELLS = 128;
+
+// Approximate maximum-coverage placement for very large candidate sets. Candidates are
+// binned into a density map whose summed-area table gives the count around every cell in
+// constant time; the best cell in reach is then refined towards the centroid of what it
+// covers. O(n + cells), no pairwise comparisons. Same reach rules as FindMaxCoverageCenter.
+bool FindDensityMapCenter(std::vector<PlacementPoint> const& points, float radius, PlacementPoint const& reachCenter, float reachRadius,
+    float& outX, float& outY, uint32_t& outHits);
+
+// Moves (x, y) onto the nearest point within 'reachRadius' of (centerX, centerY)
+void ClampToReach(float centerX, float centerY, float reachRadius, float& x, float& y);
+
+// AzerothCore-style position validation (based on SpellEffects.cpp research): pulls the
+// point into range and puts it on the ground. Deterministic, one ground query.
+void ValidateAndAdjustPosition(PlacementWorldQuery const& world, float& x, float& y, float& z, float maxRange);
+
+// Calculate optimal AOE position for the given candidates with validation. targetCount is
+// the number of candidates the validated center covers, whichever solver ran.
+AOEPosition CalculateOptimalAOEPosition(PlacementWorldQuery const& world, std::vector<PlacementPoint> const& points,
+    float aoeRadius, float maxRange, PlacementSolver solver);
+
+#endif /* ENHANCED_GROUND_TARGETING_PLACEMENT_ENGINE_H */
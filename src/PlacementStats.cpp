@@ -0,0 +1,219 @@
+#include "PlacementStats.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Log-linear buckets: exact below 4, then four buckets per power of two (at most 25% wide),
+// which is plenty to read a p99 off while staying a fixed, small array per thread.
+static constexpr uint32_t HISTOGRAM_BUCKETS = 4 * 63;
+
+static uint32_t BucketIndex(uint64_t value)
+{
+    if (value < 4)
+        return uint32_t(value);
+
+    uint32_t msb = 63 - std::countl_zero(value);
+    uint32_t sub = uint32_t(value >> (msb - 2)) & 3;
+    return 4 * (msb - 1) + sub;
+}
+
+// Smallest value landing in bucket 'index'
+static uint64_t BucketLowerBound(uint32_t index)
+{
+    if (index < 4)
+        return index;
+
+    uint32_t msb = index / 4 + 1;
+    return uint64_t(4 + index % 4) << (msb - 2);
+}
+
+// Written only by its own thread; other threads read it for reports. Relaxed atomics keep
+// that well defined without costing the writer anything over plain stores.
+struct Histogram
+{
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BUCKETS> buckets{};
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> max{ 0 };
+
+    void Record(uint64_t value)
+    {
+        std::atomic<uint64_t>& bucket = buckets[BucketIndex(value)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > max.load(std::memory_order_relaxed))
+            max.store(value, std::memory_order_relaxed);
+    }
+
+    void Reset()
+    {
+        for (std::atomic<uint64_t>& bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+
+        count.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct ThreadStats
+{
+    std::array<Histogram, MAX_PLACEMENT_STAGES> stages;
+    Histogram clusterSizes;
+    std::array<std::atomic<uint64_t>, MAX_PLACEMENT_COUNTERS> counters{};
+};
+
+// Blocks outlive their threads so a report still includes work done by exited threads
+static std::vector<std::unique_ptr<ThreadStats>> threadStats;
+static std::mutex threadStatsMutex;
+static std::atomic<bool> statsEnabled{ true };
+
+static ThreadStats& GetThreadStats()
+{
+    thread_local ThreadStats* stats = nullptr;
+    if (!stats)
+    {
+        std::lock_guard<std::mutex> lock(threadStatsMutex);
+        threadStats.push_back(std::make_unique<ThreadStats>());
+        stats = threadStats.back().get();
+    }
+
+    return *stats;
+}
+
+void SetPlacementStatsEnabled(bool enabled)
+{
+    statsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsPlacementStatsEnabled()
+{
+    return statsEnabled.load(std::memory_order_relaxed);
+}
+
+void RecordPlacementStage(PlacementStage stage, uint64_t nanoseconds)
+{
+    GetThreadStats().stages[stage].Record(nanoseconds);
+}
+
+void AddPlacementCounter(PlacementCounter counter, uint64_t count)
+{
+    if (!IsPlacementStatsEnabled())
+        return;
+
+    std::atomic<uint64_t>& value = GetThreadStats().counters[counter];
+    value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+void RecordClusterSize(uint32_t size)
+{
+    if (!IsPlacementStatsEnabled())
+        return;
+
+    GetThreadStats().clusterSizes.Record(size);
+}
+
+// Sum of one histogram over all threads
+struct HistogramTotals
+{
+    std::array<uint64_t, HISTOGRAM_BUCKETS> buckets{};
+    uint64_t count = 0;
+    uint64_t max = 0;
+
+    void Add(Histogram const& histogram)
+    {
+        for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+            buckets[i] += histogram.buckets[i].load(std::memory_order_relaxed);
+
+        count += histogram.count.load(std::memory_order_relaxed);
+        max = std::max(max, histogram.max.load(std::memory_order_relaxed));
+    }
+
+    uint64_t Percentile(double fraction) const
+    {
+        uint64_t rank = uint64_t(fraction * count);
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        {
+            seen += buckets[i];
+            if (seen > rank)
+                return BucketLowerBound(i);
+        }
+
+        return max;
+    }
+};
+
+static char const* const stageNames[MAX_PLACEMENT_STAGES] = { "candidates", "solve", "validate", "hook total" };
+
+static char const* const counterNames[MAX_PLACEMENT_COUNTERS] = { "casts intercepted", "smart placements", "target fallbacks", "self fallbacks", "placements reused",
+    "refreshed at cast end", "moved at cast end", "budget: cheaper solver", "budget: cached result", "budget: target only", "batch requests", "occluded candidates" };
+
+std::string FormatPlacementStats()
+{
+    std::array<HistogramTotals, MAX_PLACEMENT_STAGES> stages;
+    HistogramTotals clusterSizes;
+    std::array<uint64_t, MAX_PLACEMENT_COUNTERS> counters{};
+    size_t threads;
+
+    {
+        std::lock_guard<std::mutex> lock(threadStatsMutex);
+        threads = threadStats.size();
+        for (std::unique_ptr<ThreadStats> const& stats : threadStats)
+        {
+            for (uint32_t i = 0; i < MAX_PLACEMENT_STAGES; ++i)
+                stages[i].Add(stats->stages[i]);
+
+            clusterSizes.Add(stats->clusterSizes);
+            for (uint32_t i = 0; i < MAX_PLACEMENT_COUNTERS; ++i)
+                counters[i] += stats->counters[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::string report;
+    char line[160];
+
+    std::snprintf(line, sizeof(line), "Enhanced Ground Targeting stats (%zu threads)%s\n", threads, IsPlacementStatsEnabled() ? "" : " - recording disabled");
+    report += line;
+
+    for (uint32_t i = 0; i < MAX_PLACEMENT_COUNTERS; ++i)
+    {
+        std::snprintf(line, sizeof(line), "  %-22s %" PRIu64 "\n", counterNames[i], counters[i]);
+        report += line;
+    }
+
+    std::snprintf(line, sizeof(line), "  %-12s %10s %10s %10s %10s\n", "stage", "calls", "p50 us", "p99 us", "max us");
+    report += line;
+
+    for (uint32_t i = 0; i < MAX_PLACEMENT_STAGES; ++i)
+    {
+        HistogramTotals const& stage = stages[i];
+        std::snprintf(line, sizeof(line), "  %-12s %10" PRIu64 " %10.1f %10.1f %10.1f\n", stageNames[i], stage.count,
+            stage.Percentile(0.5) / 1000.0, stage.Percentile(0.99) / 1000.0, stage.max / 1000.0);
+        report += line;
+    }
+
+    std::snprintf(line, sizeof(line), "  %-12s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", "cluster size", clusterSizes.count,
+        clusterSizes.Percentile(0.5), clusterSizes.Percentile(0.99), clusterSizes.max);
+    report += line;
+
+    return report;
+}
+
+void ResetPlacementStats()
+{
+    std::lock_guard<std::mutex> lock(threadStatsMutex);
+    for (std::unique_ptr<ThreadStats> const& stats : threadStats)
+    {
+        for (Histogram& stage : stats->stages)
+            stage.Reset();
+
+        stats->clusterSizes.Reset();
+        for (std::atomic<uint64_t>& counter : stats->counters)
+            counter.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef ENHANCED_GROUND_TARGETING_PLACEMENT_STATS_H
+#define ENHANCED_GROUND_TARGETING_PLACEMENT_STATS_H
+
+// Low-overhead counters and latency histograms for the placement hot path. Every thread
+// records into its own block, so recording is a couple of uncontended relaxed stores; the
+// blocks are only summed when someone asks for a report.
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Timed stages of a placement
+enum PlacementStage : uint32_t
+{
+    PLACEMENT_STAGE_CANDIDATES = 0, // collecting the enemies to place on
+    PLACEMENT_STAGE_SOLVE      = 1, // cluster scoring / coverage search
+    PLACEMENT_STAGE_VALIDATE   = 2, // ValidateAndAdjustPosition, ground query included
+    PLACEMENT_STAGE_HOOK       = 3, // whole spell hook, from the registered-spell test on
+    MAX_PLACEMENT_STAGES
+};
+
+enum PlacementCounter : uint32_t
+{
+    PLACEMENT_COUNTER_INTERCEPTED     = 0, // casts whose destination the module set
+    PLACEMENT_COUNTER_SMART           = 1, // placements on an enemy cluster
+    PLACEMENT_COUNTER_FALLBACK_TARGET = 2, // placements on the selected unit
+    PLACEMENT_COUNTER_FALLBACK_SELF   = 3, // placements on the caster
+    PLACEMENT_COUNTER_REUSED          = 4, // hooks that reused the placement of their cast
+    PLACEMENT_COUNTER_REFRESHED       = 5, // completing casts that re-scored moved enemies
+    PLACEMENT_COUNTER_RESOLVED        = 6, // of those, casts that moved the center
+    PLACEMENT_COUNTER_DEGRADED_SOLVER = 7, // tick budget short: cheaper solver instead
+    PLACEMENT_COUNTER_DEGRADED_CACHED = 8, // tick budget spent: previous placement reused
+    PLACEMENT_COUNTER_DEGRADED_TARGET = 9, // tick budget spent: plain target position
+    PLACEMENT_COUNTER_BATCH           = 10, // placements requested through ComputeGroundPlacements
+    PLACEMENT_COUNTER_OCCLUDED        = 11, // candidates dropped for lack of line of sight
+    MAX_PLACEMENT_COUNTERS
+};
+
+// Recording is skipped entirely while disabled
+void SetPlacementStatsEnabled(bool enabled);
+bool IsPlacementStatsEnabled();
+
+void RecordPlacementStage(PlacementStage stage, uint64_t nanoseconds);
+void AddPlacementCounter(PlacementCounter counter, uint64_t count = 1);
+
+// Number of enemies a smart placement covers
+void RecordClusterSize(uint32_t size);
+
+// Times a scope into one stage
+class PlacementStageTimer
+{
+public:
+    explicit PlacementStageTimer(PlacementStage stage) : _stage(stage), _running(IsPlacementStatsEnabled())
+    {
+        if (_running)
+            _start = std::chrono::steady_clock::now();
+    }
+
+    ~PlacementStageTimer()
+    {
+        if (_running)
+            RecordPlacementStage(_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count());
+    }
+
+    PlacementStageTimer(PlacementStageTimer const&) = delete;
+    PlacementStageTimer& operator=(PlacementStageTimer const&) = delete;
+
+private:
+    PlacementStage _stage;
+    bool _running;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Human-readable totals and p50/p99/max per stage over all threads, one line per row
+std::string FormatPlacementStats();
+
+// Zeroes every thread's counters; increments racing with it may survive
+void ResetPlacementStats();
+
+#endif /* ENHANCED_GROUND_TARGETING_PLACEMENT_STATS_H */
@@ -0,0 +1,227 @@
+#include "PlacementTrace.h"
+#include <cstdio>
+#include <cstring>
+
+static char const TRACE_MAGIC[8] = { 'E', 'G', 'T', 'T', 'R', 'A', 'C', 'E' };
+static constexpr uint32_t TRACE_VERSION = 1;
+
+// Longest record a reader accepts: the fixed fields plus the most candidates a record may hold
+static constexpr size_t TRACE_MAX_RECORD_BYTES = sizeof(uint32_t) + sizeof(PlacementTraceRecord::timestampMs)
+    + sizeof(PlacementTraceRecord::spellId) + sizeof(PlacementTraceRecord::solver) + sizeof(PlacementTraceRecord::aoeRadius)
+    + sizeof(PlacementTraceRecord::maxRange) + sizeof(PlacementTraceRecord::caster) + sizeof(uint32_t)
+    + size_t(PLACEMENT_TRACE_MAX_POINTS) * sizeof(PlacementPoint) + sizeof(PlacementTraceRecord::chosen)
+    + sizeof(PlacementTraceRecord::targetCount);
+
+template<class T>
+static void Append(std::vector<char>& out, T const& value)
+{
+    char const* bytes = reinterpret_cast<char const*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<class T>
+static bool Take(char const*& cursor, char const* end, T& value)
+{
+    if (size_t(end - cursor) < sizeof(T))
+        return false;
+
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+void SerializePlacementTraceRecord(PlacementTraceRecord const& record, std::vector<char>& out)
+{
+    size_t start = out.size();
+    Append(out, uint32_t(0)); // length, patched below
+
+    Append(out, record.timestampMs);
+    Append(out, record.spellId);
+    Append(out, record.solver);
+    Append(out, record.aoeRadius);
+    Append(out, record.maxRange);
+    Append(out, record.caster);
+    Append(out, uint32_t(record.points.size()));
+    for (PlacementPoint const& point : record.points)
+        Append(out, point);
+    Append(out, record.chosen);
+    Append(out, record.targetCount);
+
+    uint32_t length = uint32_t(out.size() - start);
+    std::memcpy(out.data() + start, &length, sizeof(length));
+}
+
+bool ReadPlacementTraceHeader(std::istream& in)
+{
+    char magic[sizeof(TRACE_MAGIC)];
+    uint32_t version = 0;
+    if (!in.read(magic, sizeof(magic)) || !in.read(reinterpret_cast<char*>(&version), sizeof(version)))
+        return false;
+
+    return !std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) && version == TRACE_VERSION;
+}
+
+bool ReadPlacementTraceRecord(std::istream& in, PlacementTraceRecord& record)
+{
+    uint32_t length = 0;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length)) || length < sizeof(length) || length > TRACE_MAX_RECORD_BYTES)
+        return false;
+
+    std::vector<char> buffer(length - sizeof(length));
+    if (!in.read(buffer.data(), buffer.size()))
+        return false;
+
+    char const* cursor = buffer.data();
+    char const* end = cursor + buffer.size();
+    uint32_t count = 0;
+
+    if (!Take(cursor, end, record.timestampMs) || !Take(cursor, end, record.spellId) || !Take(cursor, end, record.solver)
+        || !Take(cursor, end, record.aoeRadius) || !Take(cursor, end, record.maxRange) || !Take(cursor, end, record.caster)
+        || !Take(cursor, end, count))
+        return false;
+
+    if (size_t(end - cursor) < size_t(count) * sizeof(PlacementPoint))
+        return false;
+
+    record.points.resize(count);
+    for (PlacementPoint& point : record.points)
+        Take(cursor, end, point);
+
+    return Take(cursor, end, record.chosen) && Take(cursor, end, record.targetCount);
+}
+
+PlacementTraceWriter::~PlacementTraceWriter()
+{
+    Stop();
+}
+
+bool PlacementTraceWriter::Start(std::string const& path, uint64_t maxFileBytes, uint32_t maxFiles)
+{
+    // Only this thread writes the settings, so they can be compared without the lock
+    if (IsRunning() && path == _path && maxFileBytes == _maxFileBytes && (maxFiles ? maxFiles : 1) == _maxFiles)
+        return true;
+
+    Stop();
+
+    _path = path;
+    _maxFileBytes = maxFileBytes;
+    _maxFiles = maxFiles ? maxFiles : 1;
+
+    // Keep the trace of the previous run (or of the settings before a reload)
+    ShiftFiles();
+    if (!OpenFile())
+        return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _running = true;
+    _stopping = false;
+    _thread = std::thread(&PlacementTraceWriter::Run, this);
+    return true;
+}
+
+void PlacementTraceWriter::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_running)
+            return;
+
+        _stopping = true;
+    }
+
+    _wake.notify_one();
+    _thread.join();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _running = false;
+    _file.close();
+}
+
+bool PlacementTraceWriter::IsRunning() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _running && !_stopping;
+}
+
+bool PlacementTraceWriter::Submit(PlacementTraceRecord record)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_running || _stopping || _queue.size() >= MAX_QUEUED_RECORDS || record.points.size() > PLACEMENT_TRACE_MAX_POINTS)
+            return false;
+
+        _queue.push_back(std::move(record));
+    }
+
+    _wake.notify_one();
+    return true;
+}
+
+void PlacementTraceWriter::Run()
+{
+    std::vector<PlacementTraceRecord> batch;
+    std::vector<char> bytes;
+
+    for (;;)
+    {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return _stopping || !_queue.empty(); });
+            stopping = _stopping;
+
+            batch.assign(std::make_move_iterator(_queue.begin()), std::make_move_iterator(_queue.end()));
+            _queue.clear();
+        }
+
+        for (PlacementTraceRecord const& record : batch)
+        {
+            bytes.clear();
+            SerializePlacementTraceRecord(record, bytes);
+
+            if (_maxFileBytes && _fileBytes + bytes.size() > _maxFileBytes)
+                Rotate();
+
+            _file.write(bytes.data(), bytes.size());
+            _fileBytes += bytes.size();
+        }
+
+        _file.flush();
+
+        if (stopping)
+            return;
+    }
+}
+
+bool PlacementTraceWriter::OpenFile()
+{
+    _file.close();
+    _file.clear();
+    _file.open(_path, std::ios::binary | std::ios::trunc);
+    if (!_file)
+        return false;
+
+    _file.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    _file.write(reinterpret_cast<char const*>(&TRACE_VERSION), sizeof(TRACE_VERSION));
+    _fileBytes = sizeof(TRACE_MAGIC) + sizeof(TRACE_VERSION);
+    return true;
+}
+
+void PlacementTraceWriter::Rotate()
+{
+    _file.close();
+    ShiftFiles();
+    OpenFile();
+}
+
+void PlacementTraceWriter::ShiftFiles()
+{
+    // path.N-2 -> path.N-1, ..., path -> path.1; the oldest file falls off the end
+    for (uint32_t i = _maxFiles - 1; i > 0; --i)
+    {
+        std::string from = i > 1 ? _path + "." + std::to_string(i - 1) : _path;
+        std::string to = _path + "." + std::to_string(i);
+        std::remove(to.c_str());
+        std::rename(from.c_str(), to.c_str());
+    }
+}
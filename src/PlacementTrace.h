@@ -0,0 +1,95 @@
+#ifndef ENHANCED_GROUND_TARGETING_PLACEMENT_TRACE_H
+#define ENHANCED_GROUND_TARGETING_PLACEMENT_TRACE_H
+
+// Binary capture of placement queries, for replaying real encounters against the engine
+// offline (tools/PlacementReplay.cpp). Core-independent like the engine itself.
+//
+// File layout: the 8-byte magic "EGTTRACE", a uint32_t version, then records back to back.
+// Each record is a uint32_t byte length followed by the fields of PlacementTraceRecord in
+// declaration order, the candidates as a uint32_t count plus x/y pairs. Numbers are stored
+// in the writer's native byte order (little-endian on every platform the core supports).
+
+#include "PlacementEngine.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One placement query and what the engine answered
+struct PlacementTraceRecord
+{
+    uint64_t timestampMs = 0; // wall clock, milliseconds since the epoch
+    uint32_t spellId = 0;
+    uint32_t solver = 0;
+    float aoeRadius = 0.0f;
+    float maxRange = 0.0f;
+    PlacementPosition caster = { 0.0f, 0.0f, 0.0f };
+    std::vector<PlacementPoint> points;
+    PlacementPosition chosen = { 0.0f, 0.0f, 0.0f };
+    uint32_t targetCount = 0;
+};
+
+// Most candidates a record may carry. Readers reject longer records before allocating for
+// them, so a corrupt length cannot ask for gigabytes; the writer drops them so every record
+// it writes can be read back.
+constexpr uint32_t PLACEMENT_TRACE_MAX_POINTS = 65536;
+
+// Writes records on a background thread, so recording costs the caller a copy and a short
+// lock. Files rotate at 'maxFileBytes': 'path' is the newest, then path.1 .. path.N-1.
+// Records are dropped, not queued without bound, when the disk falls behind.
+class PlacementTraceWriter
+{
+public:
+    ~PlacementTraceWriter();
+
+    // Starts (or restarts with new settings) writing to 'path'; keeps the current file when
+    // already running with the same settings
+    bool Start(std::string const& path, uint64_t maxFileBytes, uint32_t maxFiles);
+
+    // Flushes what is queued and stops the thread
+    void Stop();
+
+    bool IsRunning() const;
+
+    // Queues a record; false if it was dropped (writer stopped, queue full, or more than
+    // PLACEMENT_TRACE_MAX_POINTS candidates)
+    bool Submit(PlacementTraceRecord record);
+
+private:
+    static constexpr size_t MAX_QUEUED_RECORDS = 4096;
+
+    void Run();
+    bool OpenFile();
+    void Rotate();
+    void ShiftFiles();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<PlacementTraceRecord> _queue;
+    std::thread _thread;
+    bool _running = false;
+    bool _stopping = false;
+
+    // Owned by the writer thread while it runs
+    std::string _path;
+    uint64_t _maxFileBytes = 0;
+    uint32_t _maxFiles = 1;
+    std::ofstream _file;
+    uint64_t _fileBytes = 0;
+};
+
+// Bytes of one record, length prefix included
+void SerializePlacementTraceRecord(PlacementTraceRecord const& record, std::vector<char>& out);
+
+// Reads and checks the file header
+bool ReadPlacementTraceHeader(std::istream& in);
+
+// Reads the next record; false at the end of the file or on a truncated or corrupt record
+bool ReadPlacementTraceRecord(std::istream& in, PlacementTraceRecord& record);
+
+#endif /* ENHANCED_GROUND_TARGETING_PLACEMENT_TRACE_H */
@@ -0,0 +1,157 @@
+// Replays placement traces captured by the module (EnhancedGroundTargeting.Trace.Enable)
+// through the current placement engine. Reports the time each query takes now and every
+// query that now covers a different number of enemies than the center the server chose, so
+// a solver change can be judged against real encounters before it goes live. Both sides are
+// counted the same way, so --solver compares solvers fairly.
+//
+//   egt_placement_replay [--solver N] [--repeat N] [--verbose] trace [trace...]
+
+#include "PlacementEngine.h"
+#include "PlacementTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Traces do not carry terrain, so the ground is flat at the caster's height
+class ReplayWorldQuery : public PlacementWorldQuery
+{
+public:
+    explicit ReplayWorldQuery(PlacementPosition caster) : _caster(caster) {}
+
+    PlacementPosition GetCasterPosition() const override
+    {
+        return _caster;
+    }
+
+    void UpdateGroundZ(float /*x*/, float /*y*/, float& z) const override
+    {
+        z = _caster.z;
+    }
+
+private:
+    PlacementPosition _caster;
+};
+
+int main(int argc, char** argv)
+{
+    int32_t solverOverride = -1;
+    uint32_t repeat = 1;
+    bool verbose = false;
+    bool usageError = false;
+    std::vector<char const*> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--solver") && i + 1 < argc)
+        {
+            char* end = nullptr;
+            long solver = std::strtol(argv[++i], &end, 10);
+            if (*end || end == argv[i] || solver < 0 || solver >= MAX_PLACEMENT_SOLVERS)
+            {
+                usageError = true;
+                break;
+            }
+
+            solverOverride = int32_t(solver);
+        }
+        else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--verbose"))
+            verbose = true;
+        else if (argv[i][0] != '-')
+            files.push_back(argv[i]);
+        else
+        {
+            files.clear();
+            break;
+        }
+    }
+
+    if (usageError || files.empty())
+    {
+        std::fprintf(stderr, "usage: %s [--solver N] [--repeat N] [--verbose] trace [trace...]\n", argv[0]);
+        std::fprintf(stderr, "  --solver N  replay every query with solver N (0 to %d) instead of the recorded one\n", MAX_PLACEMENT_SOLVERS - 1);
+        return 1;
+    }
+
+    std::vector<double> times;
+    uint64_t improved = 0;
+    uint64_t regressed = 0;
+    uint64_t skipped = 0;
+    int64_t hitDelta = 0;
+
+    if (verbose)
+        std::printf("%8s %8s %6s %10s %8s %8s\n", "query", "spell", "units", "ns", "before", "after");
+
+    for (char const* path : files)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in || !ReadPlacementTraceHeader(in))
+        {
+            std::fprintf(stderr, "%s: not a placement trace\n", path);
+            return 1;
+        }
+
+        PlacementTraceRecord record;
+        while (ReadPlacementTraceRecord(in, record))
+        {
+            // Written by a newer module, or damaged: no solver here to replay it with
+            if (solverOverride < 0 && record.solver >= MAX_PLACEMENT_SOLVERS)
+            {
+                ++skipped;
+                continue;
+            }
+
+            ReplayWorldQuery world(record.caster);
+            PlacementSolver solver = PlacementSolver(solverOverride >= 0 ? uint32_t(solverOverride) : record.solver);
+
+            AOEPosition result;
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < repeat; ++i)
+                result = CalculateOptimalAOEPosition(world, record.points, record.aoeRadius, record.maxRange, solver);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+
+            double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / repeat;
+            times.push_back(ns);
+
+            // The recorded count means what the recording solver made it mean (the cluster
+            // solver once reported its group size), so recount the recorded center instead
+            uint32_t before = CountCoveredPoints(record.points, record.chosen.x, record.chosen.y, record.aoeRadius);
+            int64_t delta = int64_t(result.targetCount) - int64_t(before);
+            hitDelta += delta;
+            improved += delta > 0;
+            regressed += delta < 0;
+
+            if (verbose || delta < 0)
+                std::printf("%8zu %8u %6zu %10.0f %8u %8u%s\n", times.size(), record.spellId, record.points.size(), ns,
+                    before, result.targetCount, delta < 0 ? "  REGRESSED" : "");
+        }
+    }
+
+    if (skipped)
+        std::printf("%" PRIu64 " queries skipped, recorded with an unknown solver\n", skipped);
+
+    if (times.empty())
+    {
+        std::printf("no queries replayed\n");
+        return 0;
+    }
+
+    std::vector<double> sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (double ns : times)
+        total += ns;
+
+    std::printf("queries %zu  mean %.0f ns  p50 %.0f ns  p99 %.0f ns  max %.0f ns\n", times.size(), total / times.size(),
+        sorted[sorted.size() / 2], sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)], sorted.back());
+    std::printf("hits: %" PRIu64 " improved, %" PRIu64 " regressed, net %+" PRId64 "\n", improved, regressed, hitDelta);
+
+    return regressed ? 2 : 0;
+}